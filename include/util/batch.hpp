@@ -0,0 +1,156 @@
+// batch.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_BATCH_HPP
+#define INCLUDED_BATCH_HPP
+
+#include "command.hpp"
+#include "execution.hpp"
+#include "system.hpp"
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+struct batch_options
+{
+    // Headroom kept below ARG_MAX, like xargs does, for what the kernel adds to the new process.
+    static constexpr std::size_t ARG_HEADROOM = 2048;
+
+    std::size_t concurrency{ std::max(1U, std::thread::hardware_concurrency()) };
+    std::size_t max_arguments{ 0 };
+    std::size_t max_bytes{ 0 };
+    bool        ordered{ true };
+    // Stdin of every invocation, /dev/null like xargs does so that none of them drains the one of the parent. Without
+    // a value they inherit it.
+    std::optional<redirection> input{ redirection::null() };
+};
+
+struct batch_result
+{
+    std::vector<std::string> arguments{};
+    int                      status{ -1 };
+    std::string              out{};
+    std::string              err{};
+};
+
+namespace detail {
+
+inline auto
+vector_bytes(char *const *strings) -> std::size_t
+{
+    auto size = std::size_t{ 0 };
+    // NOLINTNEXTLINE: cppcoreguidelines-pro-bounds-pointer-arithmetic
+    for (; strings != nullptr && *strings != nullptr; ++strings) {
+        size += std::strlen(*strings) + 1 + sizeof(char *);
+    }
+    return size;
+}
+
+}
+
+/// Room left for extra arguments of `command`: ARG_MAX less its own argv, its environment and some headroom.
+inline auto
+argument_space(const prepared_command& command) -> std::size_t
+{
+    auto limit = static_cast<std::size_t>(std::max(::sysconf(_SC_ARG_MAX), 0L));
+    auto used  = detail::vector_bytes(command.argv()) +
+                detail::vector_bytes(command.envp()) +
+                batch_options::ARG_HEADROOM;
+    return limit > used ? limit - used : 0;
+}
+
+/// Packs `inputs` into as few argument lists as `max_bytes` and `max_arguments` allow, keeping their order.
+/// An argument too big for any list still gets one of its own, spawning it reports the error.
+template<std::ranges::input_range INPUT_T>
+    requires std::convertible_to<std::ranges::range_reference_t<INPUT_T>, std::string_view>
+auto
+argument_batches(INPUT_T&& inputs, std::size_t max_bytes, std::size_t max_arguments = 0)
+    -> std::vector<std::vector<std::string>>
+{
+    auto batches = std::vector<std::vector<std::string>>{};
+    auto bytes   = std::size_t{ 0 };
+    for (std::string_view input : inputs) {
+        auto cost = input.size() + 1 + sizeof(char *);
+        if (batches.empty() || (!batches.back().empty() && bytes + cost > max_bytes) ||
+            (max_arguments != 0 && batches.back().size() >= max_arguments)) {
+            batches.emplace_back();
+            bytes = 0;
+        }
+        batches.back().emplace_back(input);
+        bytes += cost;
+    }
+    return batches;
+}
+
+/// Runs `command` over all of `inputs` like `xargs -P`: the arguments are packed into as few invocations as the
+/// limits allow and up to `options.concurrency` of them run at once. Results come in the order of the inputs when
+/// `options.ordered` is set, in the order the invocations finished otherwise.
+template<std::ranges::input_range INPUT_T>
+    requires std::convertible_to<std::ranges::range_reference_t<INPUT_T>, std::string_view>
+auto
+run_batches(const prepared_command& command, INPUT_T&& inputs, const batch_options& options = {})
+    -> std::vector<batch_result>
+{
+    auto max_bytes = argument_space(command);
+    if (options.max_bytes != 0) {
+        max_bytes = std::min(max_bytes, options.max_bytes);
+    }
+    auto batches = argument_batches(std::forward<INPUT_T>(inputs), max_bytes, options.max_arguments);
+    auto results = std::vector<batch_result>(batches.size());
+
+    auto next     = std::atomic<std::size_t>{ 0 };
+    auto finished = std::size_t{ 0 };
+    auto lock     = std::mutex{};
+    auto failure  = std::exception_ptr{};
+    auto work     = [&] {
+        for (auto index = next++; index < batches.size(); index = next++) {
+            auto result = batch_result{ .arguments = std::move(batches[index]) };
+            try {
+                auto handler = execution(io_set::OUT | io_set::ERR);
+                if (options.input.has_value()) {
+                    handler.redirect(std_io::IN, options.input.value());
+                }
+                handler.execute(command, result.arguments);
+                auto collect  = [&result](std_io io, std::string line) {
+                    (io == std_io::OUT ? result.out : result.err) += line;
+                };
+                result.status = handler.stream(std::array<std::string_view, 0>{}, collect);
+            } catch (...) {
+                auto guard = std::lock_guard{ lock };
+                failure    = std::current_exception();
+                next       = batches.size();
+                return;
+            }
+            auto guard = std::lock_guard{ lock };
+            results[options.ordered ? index : finished++] = std::move(result);
+        }
+    };
+
+    {
+        auto workers = std::vector<std::jthread>{};
+        for (std::size_t worker = 1; worker < std::min(options.concurrency, batches.size()); ++worker) {
+            workers.emplace_back(work);
+        }
+        work();
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    return results;
+}
+
+}
+
+#endif
@@ -2,11 +2,16 @@
 #ifndef INCLUDED_BUFFER_HPP
 #define INCLUDED_BUFFER_HPP
 
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <iostream>
 #include <iterator>
 #include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace vb {
 
@@ -59,6 +64,17 @@ public:
         return read;
     }
 
+    std::size_t unload(std::span<char> out)
+    {
+        auto size = std::min(out.size(), loaded());
+        std::copy_n(used_begin, size, out.begin());
+        std::advance(used_begin, size);
+        if (used_begin == used_end) {
+            used_begin = used_end = data.begin();
+        }
+        return size;
+    }
+
     std::string unload_line()
     {
         if (used_begin == used_end) {
@@ -93,6 +109,84 @@ public:
     }
 };
 
+/// Keeps the last BUFFER_SIZE bytes appended, older ones are overwritten in place.
+template<std::size_t BUFFER_SIZE = sys::PAGE_SIZE>
+struct ring_buffer_type
+{
+    using storage_type = std::array<char, BUFFER_SIZE>;
+
+private:
+    storage_type data{};
+    std::size_t  next{ 0 };
+    std::size_t  used{ 0 };
+    std::size_t  dropped{ 0 };
+
+    void copy_in(std::string_view bytes)
+    {
+        auto first = std::min(bytes.size(), BUFFER_SIZE - next);
+        std::ranges::copy(bytes.substr(0, first), std::next(data.begin(), static_cast<std::ptrdiff_t>(next)));
+        std::ranges::copy(bytes.substr(first), data.begin());
+        next = (next + bytes.size()) % BUFFER_SIZE;
+    }
+
+    // Kept bytes are numbered from the oldest one, `at` and `copy_out` map these positions across the wrap point.
+    char at(std::size_t position) const { return data[(next + BUFFER_SIZE - used + position) % BUFFER_SIZE]; }
+
+    std::string copy_out(std::size_t from, std::size_t to) const
+    {
+        auto start  = (next + BUFFER_SIZE - used + from) % BUFFER_SIZE;
+        auto first  = std::min(to - from, BUFFER_SIZE - start);
+        auto result = std::string(std::next(data.begin(), static_cast<std::ptrdiff_t>(start)),
+                                  std::next(data.begin(), static_cast<std::ptrdiff_t>(start + first)));
+        result.append(data.begin(), std::next(data.begin(), static_cast<std::ptrdiff_t>(to - from - first)));
+        return result;
+    }
+
+public:
+    void append(std::string_view bytes)
+    {
+        if (bytes.size() >= BUFFER_SIZE) {
+            dropped += used + bytes.size() - BUFFER_SIZE;
+            bytes.remove_prefix(bytes.size() - BUFFER_SIZE);
+            next = 0;
+            used = 0;
+        }
+        auto overflow = (used + bytes.size()) - std::min(used + bytes.size(), BUFFER_SIZE);
+        dropped += overflow;
+        used = std::min(used + bytes.size(), BUFFER_SIZE);
+        copy_in(bytes);
+    }
+
+    std::size_t size() const { return used; }
+
+    /// How many bytes were overwritten so far.
+    std::size_t discarded() const { return dropped; }
+
+    std::string str() const { return copy_out(0, used); }
+
+    /// The last `count` lines kept, a line whose beginning was overwritten is left out. The newlines are looked for
+    /// backwards from the end, only the returned lines are copied.
+    std::vector<std::string> last_lines(std::size_t count) const
+    {
+        auto end    = used;
+        auto result = std::vector<std::string>{};
+        while (end > 0 && result.size() < count) {
+            // The line ending at `end` starts right after the newline before its last character.
+            auto start = end - 1;
+            while (start > 0 && at(start - 1) != '\n') {
+                --start;
+            }
+            if (start == 0 && dropped != 0) {
+                break;
+            }
+            result.push_back(copy_out(start, end));
+            end = start;
+        }
+        std::ranges::reverse(result);
+        return result;
+    }
+};
+
 }
 
 #endif
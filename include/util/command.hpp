@@ -0,0 +1,117 @@
+// command.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_COMMAND_HPP
+#define INCLUDED_COMMAND_HPP
+
+#include "environment.hpp"
+#include "system.hpp"
+
+#include <array>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <source_location>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+namespace fs = std::filesystem;
+
+/// Command line, environment and spawn attributes built once to be launched many times.
+struct prepared_command
+{
+private:
+    sys::Args                  arguments;
+    env::environment::optional environment_block;
+    std::optional<fs::path>    work_directory;
+    fs::path                   executable;
+    sys::lookup                path_lookup;
+    sys::spawn_attributes      attributes;
+
+    static constexpr auto no_environment = std::array<char *, 1>{ nullptr };
+
+public:
+    prepared_command(
+        fs::path                           exe,
+        const sys::is_arguments_type auto& args,
+        env::environment::optional         environment = {},
+        std::optional<fs::path>            cwd         = {},
+        std::source_location               source      = std::source_location::current())
+        : arguments{ exe, args }
+        , environment_block{ std::move(environment) }
+        , work_directory{ std::move(cwd) }
+        , executable{ sys::path_cache::global().resolve(exe).value_or(exe) }
+        , path_lookup{ executable.is_absolute() ? sys::lookup::NO_LOOKUP : sys::lookup::PATH }
+        , attributes{ source }
+    {
+        // Serialize the environment now so that launching only reads it.
+        static_cast<void>(envp());
+    }
+
+    explicit prepared_command(
+        fs::path                   exe,
+        env::environment::optional environment = {},
+        std::optional<fs::path>    cwd         = {},
+        std::source_location       source      = std::source_location::current())
+        : prepared_command{
+            std::move(exe), std::array<std::string, 0>{}, std::move(environment), std::move(cwd), source
+        }
+    {
+    }
+
+    prepared_command(const prepared_command&)            = delete;
+    prepared_command(prepared_command&&)                 = delete;
+    prepared_command& operator=(const prepared_command&) = delete;
+    prepared_command& operator=(prepared_command&&)      = delete;
+
+    ~prepared_command() = default;
+
+    void mode(sys::spawn_mode spawning, std::source_location source = std::source_location::current())
+    {
+        attributes.mode(spawning, source);
+    }
+
+    void scheduling(int policy, int priority = 0, std::source_location source = std::source_location::current())
+    {
+        attributes.scheduling(policy, priority, source);
+    }
+
+#ifdef __linux__
+    void affinity(std::span<const int> allowed) { attributes.affinity(allowed); }
+#endif
+
+    void nice(int value) { attributes.nice(value); }
+
+    auto lookup() const noexcept { return path_lookup; }
+
+    auto cwd() const noexcept -> const std::optional<fs::path>& { return work_directory; }
+
+    auto get_attributes() const noexcept -> const sys::spawn_attributes& { return attributes; }
+
+    /// What gets spawned, the absolute path when the name was found in $PATH.
+    auto path() const noexcept -> const char * { return executable.c_str(); }
+
+    auto argv() const noexcept -> char *const * { return arguments.data(); }
+
+    /// The prepared argv followed by `extra`, only the pointers are copied.
+    auto argv(const sys::Args& extra) const -> std::vector<char *>
+    {
+        auto result = std::vector<char *>{};
+        result.reserve(arguments.c_data.size() + extra.c_data.size());
+        result.insert(std::end(result), std::begin(arguments.c_data), std::prev(std::end(arguments.c_data)));
+        result.insert(std::end(result), std::begin(extra.c_data), std::end(extra.c_data));
+        return result;
+    }
+
+    /// Without an environment the child gets an empty one, never the one of the parent.
+    auto envp() const noexcept -> char *const *
+    {
+        return environment_block.has_value() ? environment_block.value().envp() : no_environment.data();
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+// coprocess.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_COPROCESS_HPP
+#define INCLUDED_COPROCESS_HPP
+
+#include "command.hpp"
+#include "environment.hpp"
+#include "execution.hpp"
+#include "system.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <source_location>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+/// Long lived child that answers each request line written to its stdin with response lines on its stdout.
+/// A worker that died is spawned again, a request it did not answer at all is sent once more to the new one.
+class coprocess
+{
+    prepared_command         command;
+    std::optional<execution> worker{};
+    std::size_t              spawned{ 0 };
+
+    void start()
+    {
+        if (worker.has_value()) {
+            stop();
+        }
+        worker.emplace(io_set::IN | io_set::OUT);
+        worker.value().execute(command);
+        ++spawned;
+    }
+
+    void stop()
+    {
+        worker.value().done(std_io::IN);
+        worker.value().deadline(execution::DEFAULT_GRACE);
+        worker.value().wait();
+        worker.reset();
+    }
+
+    bool send(std::string_view request)
+    {
+        try {
+            worker.value().send(request);
+            return true;
+        } catch (const std::system_error& error) {
+            if (error.code() == std::errc::broken_pipe) {
+                return false;
+            }
+            throw;
+        }
+    }
+
+    auto attempt(std::string_view request, std::size_t count, std::vector<std::string>& responses) -> bool
+    {
+        if (!send(request)) {
+            return false;
+        }
+        while (responses.size() < count) {
+            auto line = worker.value().next_line<std_io::OUT>();
+            if (!line.has_value()) {
+                return false;
+            }
+            responses.push_back(std::move(line).value());
+        }
+        return true;
+    }
+
+public:
+    coprocess(
+        fs::path                           exe,
+        const sys::is_arguments_type auto& args,
+        env::environment::optional         environment = {},
+        std::optional<fs::path>            cwd         = {},
+        std::source_location               source      = std::source_location::current())
+        : command{ std::move(exe), args, std::move(environment), std::move(cwd), source }
+    {
+        start();
+    }
+
+    explicit coprocess(
+        fs::path                   exe,
+        env::environment::optional environment = {},
+        std::optional<fs::path>    cwd         = {},
+        std::source_location       source      = std::source_location::current())
+        : coprocess{ std::move(exe), std::array<std::string, 0>{}, std::move(environment), std::move(cwd), source }
+    {
+    }
+
+    coprocess(const coprocess&)            = delete;
+    coprocess(coprocess&&)                 = delete;
+    coprocess& operator=(const coprocess&) = delete;
+    coprocess& operator=(coprocess&&)      = delete;
+
+    ~coprocess()
+    {
+        if (worker.has_value()) {
+            stop();
+        }
+    }
+
+    /// Sends `line` as one request and returns the next `count` lines of the worker.
+    auto request(std::string_view line, std::size_t count) -> std::vector<std::string>
+    {
+        // A dead worker must fail the request, not raise SIGPIPE in the caller.
+        const auto ignore_broken_pipe = sys::signal_block{ SIGPIPE };
+
+        auto responses = std::vector<std::string>{};
+        responses.reserve(count);
+        if (worker.value().status().has_value()) {
+            start();
+        }
+        if (attempt(line, count, responses)) {
+            return responses;
+        }
+        auto answered = !responses.empty();
+        start();
+        if (answered || !attempt(line, count, responses)) {
+            throw std::runtime_error("coprocess: the worker exited before answering the request");
+        }
+        return responses;
+    }
+
+    auto request(std::string_view line) -> std::string { return std::move(request(line, 1).front()); }
+
+    /// How many times the worker was spawned again after the first one.
+    auto restarts() const noexcept { return spawned - 1; }
+
+    auto pid() const noexcept { return worker.has_value() ? worker.value().get_pid() : -1; }
+};
+
+/// Identical coprocesses shared between threads, a request waits until one of them is idle.
+class coprocess_pool
+{
+    std::vector<std::unique_ptr<coprocess>> workers{};
+    std::vector<coprocess *>                idle{};
+    std::mutex                              lock{};
+    std::condition_variable                 released{};
+
+    auto acquire() -> coprocess&
+    {
+        auto guard = std::unique_lock{ lock };
+        released.wait(guard, [this] { return !idle.empty(); });
+        auto *worker = idle.back();
+        idle.pop_back();
+        return *worker;
+    }
+
+    void release(coprocess& worker)
+    {
+        {
+            auto guard = std::lock_guard{ lock };
+            idle.push_back(&worker);
+        }
+        released.notify_one();
+    }
+
+public:
+    coprocess_pool(
+        std::size_t                        size,
+        const fs::path&                    exe,
+        const sys::is_arguments_type auto& args,
+        const env::environment::optional&  environment = {},
+        const std::optional<fs::path>&     cwd         = {},
+        std::source_location               source      = std::source_location::current())
+    {
+        workers.reserve(size);
+        for (std::size_t index = 0; index < size; ++index) {
+            workers.push_back(std::make_unique<coprocess>(exe, args, environment, cwd, source));
+            idle.push_back(workers.back().get());
+        }
+    }
+
+    auto request(std::string_view line, std::size_t count) -> std::vector<std::string>
+    {
+        auto& worker = acquire();
+        try {
+            auto result = worker.request(line, count);
+            release(worker);
+            return result;
+        } catch (...) {
+            release(worker);
+            throw;
+        }
+    }
+
+    auto request(std::string_view line) -> std::string { return std::move(request(line, 1).front()); }
+
+    auto size() const noexcept { return workers.size(); }
+};
+
+}
+
+#endif
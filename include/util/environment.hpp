@@ -302,7 +302,84 @@ private:
         return a.name().raw_string() < b.name().raw_string();
     }
 
+    // Contiguous `NAME=VALUE\0` copy of the definitions with the `envp` array pointing into it.
+    struct block_type
+    {
+        std::string         data{};
+        std::vector<char *> index{ nullptr };
+        bool                ready{ false };
+
+        block_type() = default;
+
+        block_type(const block_type& other)
+            : data{ other.data }
+            , ready{ other.ready }
+        {
+            reindex();
+        }
+
+        block_type(block_type&& other)
+            : data{ std::move(other.data) }
+            , ready{ other.ready }
+        {
+            reindex();
+        }
+
+        block_type& operator=(const block_type& other)
+        {
+            data  = other.data;
+            ready = other.ready;
+            reindex();
+            return *this;
+        }
+
+        block_type& operator=(block_type&& other)
+        {
+            data  = std::move(other.data);
+            ready = other.ready;
+            reindex();
+            return *this;
+        }
+
+        ~block_type() = default;
+
+        void reindex()
+        {
+            index.clear();
+            for (std::size_t pos = 0; pos < data.size(); pos = data.find(SEPARATOR, pos) + 1) {
+                index.push_back(data.data() + pos);
+            }
+            index.push_back(nullptr);
+        }
+
+        void append(std::string_view definition)
+        {
+            const auto *old_data = data.data();
+            const auto  offset   = data.size();
+            data.append(definition);
+            data.push_back(SEPARATOR);
+            if (data.data() != old_data) {
+                reindex();
+            } else {
+                index.back() = data.data() + offset;
+                index.push_back(nullptr);
+            }
+        }
+
+        void rebuild(const std::vector<variable>& definitions)
+        {
+            data.clear();
+            for (const auto& var : definitions) {
+                data.append(var.definition_view());
+                data.push_back(SEPARATOR);
+            }
+            reindex();
+            ready = true;
+        }
+    };
+
     std::vector<variable> definitions{};
+    mutable block_type    block{};
 
     static auto grab_data(variable& var)
     {
@@ -346,10 +423,22 @@ public:
     {
         if (auto old = std::ranges::find(definitions, var.name(), &variable::name); old != std::end(definitions)) {
             definitions.erase(old);
+            block.ready = false;
+        } else if (block.ready) {
+            block.append(var.definition_view());
         }
         definitions.push_back(var);
     }
 
+    /// Null terminated `NAME=VALUE` array ready to be handed to `posix_spawn`, valid until the next change.
+    auto envp() const -> char *const *
+    {
+        if (!block.ready) {
+            block.rebuild(definitions);
+        }
+        return block.index.data();
+    }
+
     bool import(auto var)
     {
         variable definition = variable::from_system(var);
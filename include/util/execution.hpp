@@ -2,21 +2,35 @@
 #define INCLUDED_EXECUTION_HPP
 
 #include "./filesystem.hpp"
+#include "buffer.hpp"
+#include "command.hpp"
 #include "generator.hpp"
 #include "pipe.hpp"
+#include "pipe_set.hpp"
+#include "reactor.hpp"
 #include "system.hpp"
+#include "task.hpp"
 #include "util/environment.hpp"
 
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <variant>
+#include <vector>
 
 namespace vb {
 
@@ -89,8 +103,90 @@ operator|(std_io_or_set auto first, std_io_or_set auto second)
     return static_cast<io_set>(static_cast<std::uint8_t>(to_set(first)) | static_cast<std::uint8_t>(to_set(second)));
 }
 
+/// Iterable of chunks for a child stdin, every chunk has to stay alive until the iteration moves past it.
+template<typename INPUT_T>
+concept chunk_source = requires(INPUT_T& input) {
+    { *std::begin(input) } -> std::convertible_to<std::string_view>;
+    std::begin(input) != std::end(input);
+};
+
+/// Binds a child standard stream to a file or descriptor, the data then never passes through the parent.
+struct redirection
+{
+    static constexpr int    DEFAULT_FLAGS = -1;
+    static constexpr mode_t DEFAULT_MODE  = 0666;
+
+    std::variant<int, fs::path> target;
+    int                         flags{ DEFAULT_FLAGS };
+    mode_t                      mode{ DEFAULT_MODE };
+
+    static auto fd(int descriptor) -> redirection { return redirection{ .target = descriptor }; }
+
+    static auto file(fs::path path, int open_flags = DEFAULT_FLAGS, mode_t create_mode = DEFAULT_MODE)
+        -> redirection
+    {
+        return redirection{ .target = std::move(path), .flags = open_flags, .mode = create_mode };
+    }
+
+    static auto null() -> redirection { return file("/dev/null", O_RDWR); }
+
+    constexpr auto open_flags(std_io io) const -> int
+    {
+        if (flags != DEFAULT_FLAGS) {
+            return flags;
+        }
+        return io == std_io::IN ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+    }
+};
+
+struct execution_timing
+{
+    using clock      = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+
+    std::optional<time_point> spawned{};
+    std::optional<time_point> first_output{};
+    // When a wait noticed the exit, which can be well after the child really exited.
+    std::optional<time_point> exited{};
+
+    auto wall_time() const -> std::optional<clock::duration>
+    {
+        if (!spawned.has_value() || !exited.has_value()) {
+            return {};
+        }
+        return exited.value() - spawned.value();
+    }
+};
+
+/// A line of stdout or stderr with the time the read that got it woke up.
+struct timed_line
+{
+    std_io                       io;
+    execution_timing::time_point at;
+    std::string                  text;
+};
+
+enum class termination_stage : std::uint8_t
+{
+    NONE,
+    TERMINATED,
+    KILLED
+};
+
+class process_group;
+
 struct execution
 {
+    using clock = execution_timing::clock;
+
+    static constexpr auto DEFAULT_GRACE = std::chrono::seconds{ 5 };
+
+    // Bytes gathered from small stdin chunks before they are written, the default capacity of a Linux pipe.
+    static constexpr std::size_t FEED_BATCH = 64 * KB;
+
+    // Default block size of `chunks`, as much as a full Linux pipe holds.
+    static constexpr std::size_t CHUNK_SIZE = 64 * KB;
+
 private:
     struct redirection_pipes
     {
@@ -160,53 +256,158 @@ private:
         }
     };
 
-    redirection_pipes pipes;
-    pid_t             pid{ -1 };
-    sys::status_type  current_status{};
-    sys::spawn        spawner{};
-
-    auto make_args(fs::path exec, std::ranges::sized_range auto arguments)
-    {
-        auto result = std::pair{std::vector<std::string>{}, std::vector<const char *>{}};
-        result.first.reserve(std::ranges::size(arguments) + 1);
-        result.second.reserve(std::ranges::size(arguments) + 1);
-        result.first.push_back(exec.string());
-        std::ranges::copy(
-            arguments | std::views::transform([]<typename T>(const T& dt) {
-                if constexpr (std::same_as<std::string, T>) {
-                    return dt;
-                } else if constexpr (std::constructible_from<std::string, T>){
-                    return std::string{dt};
-                }
-            }),
-            std::back_insert_iterator(result.first));
-        std::ranges::copy(
-            result.first | std::views::transform([](const auto& arg) { return arg.data(); }),
-            std::back_insert_iterator(result.second));
+    redirection_pipes                           pipes;
+    std::array<std::optional<redirection>, 3>   bound_streams{};
+    pid_t                                       pid{ -1 };
+    sys::status_type                            current_status{};
+    std::optional<sys::resource_usage>          child_usage{};
+    execution_timing                            times{};
+    int                                         exit_fd{ -1 };
+    std::optional<execution_timing::time_point> deadline_at{};
+    clock::duration                             grace_period{};
+    termination_stage                           termination{ termination_stage::NONE };
+    std::optional<int>                          close_lowest{};
+    sys::spawn                                  spawner{};
+
+    auto launch(
+        sys::lookup                    path_lookup,
+        const char                    *path,
+        char *const                   *argv,
+        char *const                   *envp,
+        const std::optional<fs::path>& cwd,
+        const sys::spawn_attributes&   defaults,
+        std::source_location           source)
+    {
+        // What was set on this execution wins over the attributes of a prepared command.
+        spawner.inherit(defaults, source);
+        if (cwd.has_value()) {
+            spawner.cwd(cwd.value(), source);
+        }
+        pipes.for_each_pipe([&](std_io io, vb::pipe& open_pipe) {
+            spawner.add_close(open_pipe.get_fd(!direction(io)), source);
+            spawner.setup_dup2(open_pipe.get_fd(direction(io)), get_fd(io), source);
+            spawner.add_close(open_pipe.get_fd(direction(io)), source);
+        });
+        for (const auto io : { std_io::IN, std_io::OUT, std_io::ERR }) {
+            const auto& target = bound_streams.at(static_cast<std::size_t>(io));
+            if (!target.has_value()) {
+                continue;
+            }
+            if (const auto *fd = std::get_if<int>(&target.value().target); fd != nullptr) {
+                spawner.setup_dup2(*fd, get_fd(io), source);
+            } else {
+                spawner.add_open(
+                    get_fd(io),
+                    std::get<fs::path>(target.value().target),
+                    target.value().open_flags(io),
+                    target.value().mode,
+                    source);
+            }
+        }
+
+        if (close_lowest.has_value()) {
+            spawner.close_from(close_lowest.value(), source);
+        }
+
+        auto result = spawner(path_lookup, path, argv, envp, spawner.get_attributes(), source);
+
+        times.spawned = execution_timing::clock::now();
+        pid           = spawner.get_pid();
+
+        pipes.for_each_pipe([&](std_io io, vb::pipe& open_pipe) { open_pipe.set_direction(!direction(io)); });
         return result;
     }
 
+    auto exit_descriptor() -> int
+    {
+#ifdef SYS_pidfd_open
+        if (exit_fd == -1 && pid != -1 && !current_status.has_value()) {
+            exit_fd = sys::pidfd_open(pid);
+        }
+#endif
+        return exit_fd;
+    }
+
+    auto next_escalation() const -> std::optional<execution_timing::time_point>
+    {
+        if (!deadline_at.has_value() || current_status.has_value()) {
+            return {};
+        }
+        switch (termination) {
+        case termination_stage::NONE:
+            return deadline_at.value();
+        case termination_stage::TERMINATED:
+            return deadline_at.value() + grace_period;
+        case termination_stage::KILLED:
+            return {};
+        }
+        return {};
+    }
+
+    auto deadline_timeout() const -> std::chrono::milliseconds
+    {
+        using namespace std::literals;
+        if (auto next = next_escalation(); next.has_value()) {
+            return std::max(0ms, std::chrono::ceil<std::chrono::milliseconds>(next.value() - clock::now()));
+        }
+        return -1ms;
+    }
+
+    // Blocks until `fd` is readable, the child exits or the next deadline step is due.
+    void wait_ready(int fd)
+    {
+        using namespace std::literals;
+        enforce_deadline();
+
+        auto timeout = deadline_timeout();
+        auto exit    = exit_descriptor();
+        if (exit == -1 && (timeout < 0ms || timeout > 10ms)) {
+            // Without a pidfd the exit can only be noticed by polling the status.
+            timeout = 10ms;
+        }
+        sys::poll(timeout, sys::poll_arg{ .fd = fd, .events = POLLIN }, sys::poll_arg{ .fd = exit, .events = POLLIN });
+    }
+
+    // The child was reaped by a wait on its whole process group.
+    void reaped(int status, const sys::resource_usage& usage)
+    {
+        current_status = status;
+        child_usage    = usage;
+        times.exited   = execution_timing::clock::now();
+    }
+
+    friend class vb::process_group;
+
 public:
     execution(io_set redirections = io_set::NONE)
         : pipes{ redirections }
     {
     }
 
+    execution(const execution&)            = delete;
+    execution(execution&&)                 = delete;
+    execution& operator=(const execution&) = delete;
+    execution& operator=(execution&&)      = delete;
+
+    ~execution()
+    {
+        if (exit_fd != -1) {
+            ::close(exit_fd);
+        }
+    }
+
     template<bool BLOCK>
     auto exec_wait()
     {
-        auto wait_func = [&]() {
-            if constexpr (BLOCK) {
-                return sys::wait_pid(pid);
-            } else {
-                return sys::status_pid(pid);
-            }
-        };
-
         if (current_status.has_value()) {
             return current_status;
         }
-        current_status = wait_func();
+        auto usage     = sys::resource_usage{};
+        current_status = sys::wait_pid(pid, BLOCK ? 0 : WNOHANG, usage);
+        if (current_status.has_value()) {
+            times.exited = execution_timing::clock::now();
+            child_usage  = usage;
+        }
         return current_status;
     }
 
@@ -219,10 +420,106 @@ public:
             while (!input.closed() && !current_status.has_value()) {
                 if (auto val = input(); val) {
                     co_yield val.value();
+                } else if (!exec_wait<false>().has_value()) {
+                    wait_ready(input.get_fd(io_direction::READ));
+                }
+            }
+            for (auto val = input(); val; val = input()) {
+                co_yield val.value();
+            }
+        }
+    }
+
+    /// Lines of stdout and stderr in the order they arrived. A single poll waits on both pipes, each ready one is read
+    /// once per wakeup and the clock is read once too, the lines of that wakeup share its time with the stdout ones
+    /// first.
+    generator<timed_line> merged_lines()
+    {
+        auto open = [this](std_io io) { return pipes[io].has_value() && !pipes[io].value().closed(); };
+        auto read_fd = [this](std_io io) {
+            return pipes[io].has_value() ? pipes[io].value().get_fd(io_direction::READ) : -1;
+        };
+        while (open(std_io::OUT) || open(std_io::ERR)) {
+            enforce_deadline();
+            auto ready = sys::poll(
+                deadline_timeout(),
+                sys::poll_arg{ .fd = read_fd(std_io::OUT), .events = POLLIN },
+                sys::poll_arg{ .fd = read_fd(std_io::ERR), .events = POLLIN });
+            auto now   = clock::now();
+            for (const auto io : { std_io::OUT, std_io::ERR }) {
+                // A pipe that did not wake the poll has no new line, its partial one waits for more.
+                if (ready.at(io == std_io::OUT ? 0 : 1) == 0) {
+                    continue;
+                }
+                // Reading until the pipe is empty would starve the other one while this child keeps writing.
+                auto& input = pipes[io].value();
+                input.fill();
+                for (auto line = input.buffered_line(); line; line = input.buffered_line()) {
+                    auto timed = timed_line{ .io = io, .at = now, .text = std::move(line).value() };
+                    co_yield std::move(timed);
+                }
+            }
+        }
+    }
+
+    /// Raw output of `IO` in blocks as they arrive, without looking for lines. All blocks share one buffer of `size`
+    /// bytes, 0 takes CHUNK_SIZE, a block is only valid until the iteration moves on.
+    template<std_io IO>
+    generator<std::span<const std::byte>> chunks(std::size_t size = CHUNK_SIZE)
+    {
+        auto& opt_input = pipes[IO];
+        if (opt_input.has_value()) {
+            auto& input = opt_input.value();
+            auto  block = std::vector<char>(size == 0 ? CHUNK_SIZE : size);
+            while (!input.closed()) {
+                if (auto read = input.read_some(block); read > 0) {
+                    co_yield std::as_bytes(std::span{ block.data(), read });
+                } else if (input.get_fd(io_direction::READ) == -1 || exec_wait<false>().has_value()) {
+                    for (read = input.read_some(block); read > 0; read = input.read_some(block)) {
+                        co_yield std::as_bytes(std::span{ block.data(), read });
+                    }
+                    break;
                 } else {
-                    exec_wait<false>();
+                    wait_ready(input.get_fd(io_direction::READ));
+                }
+            }
+        }
+    }
+
+    /// Blocks until the next line of `IO`, nothing once the child is gone and all its output was read.
+    template<std_io IO>
+    auto next_line() -> std::optional<std::string>
+    {
+        auto& opt_input = pipes[IO];
+        if (!opt_input.has_value()) {
+            return std::nullopt;
+        }
+        auto& input = opt_input.value();
+        while (true) {
+            auto line = input();
+            if (line) {
+                return std::move(line).value();
+            }
+            if (input.get_fd(io_direction::READ) == -1) {
+                return std::nullopt;
+            }
+            if (exec_wait<false>().has_value()) {
+                // The write end is closed now, this read reaches the end of file.
+                if (line = input(); line) {
+                    return std::move(line).value();
                 }
+                return std::nullopt;
             }
+            wait_ready(input.get_fd(io_direction::READ));
+        }
+    }
+
+    /// Reads `IO` until the child is done with it, only the last bytes are kept in `sink`.
+    template<std_io IO, std::size_t SIZE>
+    void capture_tail(ring_buffer_type<SIZE>& sink)
+    {
+        for (auto block : chunks<IO>()) {
+            sink.append(std::string_view{ reinterpret_cast<const char *>(block.data()), block.size() });
         }
     }
 
@@ -230,38 +527,213 @@ public:
         fs::path                      exe,
         std::ranges::sized_range auto args,
         env::environment::optional    environment = {},
-        fs::path                      cwd         = fs::current_path(),
+        std::optional<fs::path>       cwd         = {},
         std::source_location          source      = std::source_location::current())
     {
-        spawner.cwd(cwd);
-        pipes.for_each_pipe([&](std_io io, vb::pipe& open_pipe) {
-            spawner.add_close(open_pipe.get_fd(!direction(io)), source);
-            spawner.setup_dup2(open_pipe.get_fd(direction(io)), get_fd(io), source);
-            spawner.add_close(open_pipe.get_fd(direction(io)), source);
-        });
-
-        auto all_args = make_args(exe, args);
-
-        auto lookup = exe.is_absolute() ? sys::lookup::NO_LOOKUP : sys::lookup::PATH;
-
-        auto environ = environment.has_value() ? environment.value().getEnv() : std::vector<std::string>{};
-        auto result  = spawner(lookup, all_args.second, environ);
+        const auto command = prepared_command{ exe, args, std::move(environment), std::move(cwd), source };
+        return launch(
+            command.lookup(),
+            command.path(),
+            command.argv(),
+            command.envp(),
+            command.cwd(),
+            command.get_attributes(),
+            source);
+    }
 
-        pid = spawner.get_pid();
+    auto execute(
+        const prepared_command&     command,
+        sys::is_arguments_type auto extra_args,
+        std::source_location        source = std::source_location::current())
+    {
+        if (std::ranges::empty(extra_args)) {
+            return launch(
+                command.lookup(),
+                command.path(),
+                command.argv(),
+                command.envp(),
+                command.cwd(),
+                command.get_attributes(),
+                source);
+        }
+        auto extra = sys::Args{ extra_args };
+        auto argv  = command.argv(extra);
+        return launch(
+            command.lookup(),
+            command.path(),
+            argv.data(),
+            command.envp(),
+            command.cwd(),
+            command.get_attributes(),
+            source);
+    }
 
-        pipes.for_each_pipe([&](std_io io, vb::pipe& open_pipe) { open_pipe.set_direction(!direction(io)); });
-        return result;
+    auto execute(const prepared_command& command, std::source_location source = std::source_location::current())
+    {
+        return execute(command, std::array<std::string, 0>{}, source);
     }
 
     auto execute(
         is_path_like auto          exe,
         env::environment::optional environment = {},
-        fs::path                   cwd         = fs::current_path(),
+        std::optional<fs::path>    cwd         = {},
         std::source_location       source      = std::source_location::current())
     {
         return execute(exe, std::array<std::string, 0>{}, environment, cwd, source);
     }
 
+    /// Feeds the chunks of `input` to the child stdin while handing each stdout and stderr line to `on_line`.
+    /// Everything happens in this thread on non blocking writes, so neither side can fill up and stall the other.
+    template<std::invocable<std_io, std::string> CALLBACK_T>
+    auto stream(chunk_source auto&& input, CALLBACK_T&& on_line) -> int
+    {
+        // A child that stops reading must end the feeding, not the parent.
+        const auto ignore_broken_pipe = sys::signal_block{ SIGPIPE };
+
+        auto feeding  = pipes[std_io::IN].has_value();
+        auto write_fd = feeding ? pipes[std_io::IN].value().get_fd(io_direction::WRITE) : -1;
+        auto next     = std::begin(input);
+        auto last     = std::end(input);
+        auto staged   = std::string{};
+        auto unsent   = std::string_view{};
+        auto direct   = false;
+        if (feeding) {
+            sys::set_nonblocking(write_fd);
+        }
+
+        // Chunks are only pulled once the pipe takes more. Small ones are gathered into one write, a large one the
+        // source keeps alive is written from where it is and the iteration waits until it is sent.
+        auto refill = [&] {
+            if (std::exchange(direct, false)) {
+                ++next;
+            }
+            staged.clear();
+            while (next != last && staged.size() < FEED_BATCH) {
+                decltype(auto) chunk = *next;
+                auto           view  = std::string_view{ chunk };
+                if constexpr (std::is_lvalue_reference_v<decltype(chunk)>) {
+                    if (staged.empty() && view.size() >= FEED_BATCH) {
+                        unsent = view;
+                        direct = true;
+                        return;
+                    }
+                }
+                staged += view;
+                ++next;
+            }
+            unsent = staged;
+        };
+
+        // Writes until the pipe is full, false once there is nothing more to send.
+        auto feed = [&] {
+            while (true) {
+                if (unsent.empty()) {
+                    refill();
+                }
+                if (unsent.empty()) {
+                    return false;
+                }
+                auto written = sys::write_some(write_fd, unsent.data(), unsent.size());
+                if (written < 0) {
+                    return errno == EAGAIN;
+                }
+                unsent.remove_prefix(static_cast<std::size_t>(written));
+            }
+        };
+        auto open = [&](std_io io) { return pipes[io].has_value() && !pipes[io].value().closed(); };
+        auto read_fd = [&](std_io io) {
+            return pipes[io].has_value() ? pipes[io].value().get_fd(io_direction::READ) : -1;
+        };
+        auto drain = [&](std_io io) {
+            if (!pipes[io].has_value()) {
+                return;
+            }
+            for (auto line = pipes[io].value()(); line; line = pipes[io].value()()) {
+                std::invoke(on_line, io, std::move(line).value());
+            }
+        };
+
+        while (feeding || open(std_io::OUT) || open(std_io::ERR)) {
+            enforce_deadline();
+            auto ready = sys::poll(
+                deadline_timeout(),
+                sys::poll_arg{ .fd = feeding ? write_fd : -1, .events = POLLOUT },
+                sys::poll_arg{ .fd = read_fd(std_io::OUT), .events = POLLIN },
+                sys::poll_arg{ .fd = read_fd(std_io::ERR), .events = POLLIN });
+            if (feeding && ready[0] != 0 && !feed()) {
+                feeding = false;
+                done(std_io::IN);
+            }
+            drain(std_io::OUT);
+            drain(std_io::ERR);
+        }
+        return wait();
+    }
+
+    template<std::invocable<std_io, std::string> CALLBACK_T>
+    auto stream(std::string_view input, CALLBACK_T&& on_line) -> int
+    {
+        return stream(std::array{ input }, std::forward<CALLBACK_T>(on_line));
+    }
+
+    /// Feeds `input`, a range or a vb::generator producing it lazily, to the child stdin and waits for the child.
+    /// Output lines read from pipes are dropped.
+    auto feed(chunk_source auto&& input) -> int
+    {
+        return stream(std::forward<decltype(input)>(input), [](std_io, const std::string&) {});
+    }
+
+    /// Bytes read from the `io` pipe are forwarded to `fd` as they are consumed, the lines stay available.
+    void tee(std_io io, int fd)
+    {
+        if (auto& input = pipes[io]; input.has_value()) {
+            input.value().tee(fd);
+        }
+    }
+
+#ifdef __linux__
+    /// Lines of `io` are handed to `on_line` by the loop of `set`, with many children supervised from one thread.
+    void watch(pipe_set& set, std_io io, pipe_set::line_callback on_line, pipe_set::end_callback on_end = {})
+    {
+        if (auto& input = pipes[io]; input.has_value()) {
+            set.add(input.value(), std::move(on_line), std::move(on_end));
+        }
+    }
+#endif
+
+    /// Replaces the pipe of `io`, if any, a descriptor target has to stay open until `execute` returns.
+    void redirect(std_io io, redirection target)
+    {
+        pipes[io].reset();
+        bound_streams.at(static_cast<std::size_t>(io)) = std::move(target);
+    }
+
+    void mode(sys::spawn_mode spawning, std::source_location source = std::source_location::current())
+    {
+        spawner.mode(spawning, source);
+    }
+
+    /// The child joins process `group`, or leads a new one named after its pid when `group` is 0.
+    void process_group(pid_t group = 0, std::source_location source = std::source_location::current())
+    {
+        spawner.process_group(group, source);
+    }
+
+    /// Scheduling policy and priority of the child, see sys::spawn_attributes::scheduling.
+    void scheduling(int policy, int priority = 0, std::source_location source = std::source_location::current())
+    {
+        spawner.scheduling(policy, priority, source);
+    }
+
+#ifdef __linux__
+    void affinity(std::span<const int> allowed) { spawner.affinity(allowed); }
+#endif
+
+    void nice(int value) { spawner.nice(value); }
+
+    /// The child gets no descriptor from `lowest` up, besides its standard streams nothing is inherited by default.
+    void close_from(int lowest = 3) { close_lowest = lowest; }
+
     auto done(std_io io)
     {
         if (pipes[io].has_value()) {
@@ -269,9 +741,111 @@ public:
         }
     }
 
-    auto wait() -> int { return exec_wait<true>().value_or(-1); }
+    auto wait() -> int
+    {
+        while (deadline_at.has_value() && !exec_wait<false>().has_value()) {
+            wait_ready(-1);
+        }
+        return exec_wait<true>().value_or(-1);
+    }
+
+    /// From now on the child has `timeout` to finish, then it gets SIGTERM, and SIGKILL once `grace` is over.
+    void deadline(clock::duration timeout, clock::duration grace = DEFAULT_GRACE)
+    {
+        deadline_at  = clock::now() + timeout;
+        grace_period = grace;
+    }
+
+    /// Sends the signal that is due, `wait` and `lines` already call it while they block.
+    void enforce_deadline()
+    {
+        auto next = next_escalation();
+        if (!next.has_value() || clock::now() < next.value() || exec_wait<false>().has_value()) {
+            return;
+        }
+        if (termination == termination_stage::NONE) {
+            sys::kill(pid, SIGTERM);
+            termination = termination_stage::TERMINATED;
+        } else {
+            sys::kill(pid, SIGKILL);
+            termination = termination_stage::KILLED;
+        }
+    }
+
+    auto timed_out() const noexcept { return termination != termination_stage::NONE; }
+
+    template<can_be_outstreamed... DATA_Ts>
+    void send(DATA_Ts... data)
+    {
+        if (auto& output = pipes[std_io::IN]; output.has_value()) {
+            output.value()(data...);
+        }
+    }
+
+#ifdef __linux__
+    task<int> wait(reactor& loop)
+    {
+        using namespace std::literals;
+        if (current_status.has_value()) {
+            co_return current_status.value();
+        }
+        if (auto exit = exit_descriptor(); exit != -1) {
+            co_await loop.readable(exit);
+            co_return wait();
+        }
+        while (!status().has_value()) {
+            co_await loop.sleep_for(1ms);
+        }
+        co_return current_status.value();
+    }
+
+    template<std_io IO>
+    task<std::optional<std::string>> next_line(reactor& loop)
+    {
+        auto& opt_input = pipes[IO];
+        if (!opt_input.has_value()) {
+            co_return std::nullopt;
+        }
+        auto& input = opt_input.value();
+        while (true) {
+            if (auto line = input(); line) {
+                co_return std::move(line).value();
+            }
+            if (input.get_fd(io_direction::READ) == -1) {
+                co_return std::nullopt;
+            }
+            co_await loop.readable(input.get_fd(io_direction::READ));
+        }
+    }
+
+    task<void> writable(reactor& loop)
+    {
+        if (auto& output = pipes[std_io::IN]; output.has_value()) {
+            co_await loop.writable(output.value().get_fd(io_direction::WRITE));
+        }
+    }
+#endif
 
     auto status() -> sys::status_type { return exec_wait<false>(); }
+
+    auto get_pid() const noexcept { return pid; }
+
+    /// What the child consumed, available once it has been waited for.
+    auto usage() const noexcept -> const std::optional<sys::resource_usage>& { return child_usage; }
+
+    /// The first output is the first read that got bytes from the stdout or stderr pipe, output going elsewhere or
+    /// never read does not count.
+    auto timing() const -> execution_timing
+    {
+        auto result = times;
+        for (const auto io : { std_io::OUT, std_io::ERR }) {
+            if (const auto& input = pipes[io]; input.has_value() && input.value().first_read().has_value()) {
+                auto read           = input.value().first_read().value();
+                result.first_output = std::min(result.first_output.value_or(read), read);
+            }
+        }
+        return result;
+    }
 };
 
 }
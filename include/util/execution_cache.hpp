@@ -0,0 +1,239 @@
+// execution_cache.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_EXECUTION_CACHE_HPP
+#define INCLUDED_EXECUTION_CACHE_HPP
+
+#include "environment.hpp"
+#include "execution.hpp"
+#include "system.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ranges>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+namespace fs = std::filesystem;
+
+/// 64 bit FNV-1a, stable between runs so that it can name the files of an on-disk store.
+class fnv1a
+{
+    static constexpr std::uint64_t OFFSET = 14695981039346656037ULL;
+    static constexpr std::uint64_t PRIME  = 1099511628211ULL;
+
+    std::uint64_t state{ OFFSET };
+
+public:
+    constexpr void add(std::string_view bytes)
+    {
+        for (auto byte : bytes) {
+            state ^= static_cast<unsigned char>(byte);
+            state *= PRIME;
+        }
+    }
+
+    constexpr auto value() const noexcept { return state; }
+};
+
+struct execution_result
+{
+    int         status{ -1 };
+    std::string out{};
+    std::string err{};
+};
+
+/// Outputs and statuses of deterministic commands, a hit does not create any process.
+/// The key covers the executable path and modification time, the arguments, the working directory and the
+/// values of the environment variables chosen at construction. Entries keep these fields and only answer for
+/// exactly the same ones, the hash merely names the files of the store.
+class execution_cache
+{
+    std::unordered_map<std::string, execution_result> entries{};
+    std::vector<std::string>                           key_variables;
+    std::optional<fs::path>                            store;
+    std::size_t                                        hit_count{ 0 };
+    std::size_t                                        miss_count{ 0 };
+
+    static auto resolve(const fs::path& exe) -> fs::path
+    {
+        if (exe.has_parent_path()) {
+            return fs::absolute(exe);
+        }
+        return sys::path_cache::global().resolve(exe).value_or(exe);
+    }
+
+    static auto hash(std::string_view fields) -> std::uint64_t
+    {
+        auto state = fnv1a{};
+        state.add(fields);
+        return state.value();
+    }
+
+    auto file_for(std::uint64_t id) const
+    {
+        auto name = std::array<char, 16>{};
+        for (auto& digit : name | std::views::reverse) {
+            digit = "0123456789abcdef"[id & 0xFU];
+            id >>= 4U;
+        }
+        return store.value() / std::string_view{ name.data(), name.size() };
+    }
+
+    // A stored file whose fields differ, after a hash collision or from an older executable, is a miss.
+    auto load(const std::string& fields) const -> std::optional<execution_result>
+    {
+        if (!store.has_value()) {
+            return {};
+        }
+        auto file   = std::ifstream{ file_for(hash(fields)), std::ios::binary };
+        auto stored = std::size_t{ 0 };
+        auto out    = std::size_t{ 0 };
+        auto err    = std::size_t{ 0 };
+        auto read   = execution_result{};
+        if (!(file >> stored >> read.status >> out >> err) || file.get() != '\n' || stored != fields.size()) {
+            return {};
+        }
+        auto found = std::string(stored, '\0');
+        read.out.resize(out);
+        read.err.resize(err);
+        if (!file.read(found.data(), static_cast<std::streamsize>(stored)) || found != fields ||
+            !file.read(read.out.data(), static_cast<std::streamsize>(out)) ||
+            !file.read(read.err.data(), static_cast<std::streamsize>(err))) {
+            return {};
+        }
+        return read;
+    }
+
+    void save(const std::string& fields, const execution_result& result) const
+    {
+        if (!store.has_value()) {
+            return;
+        }
+        fs::create_directories(store.value());
+        // Readers never see half a file, the rename replaces it at once. Every writer, other threads of this
+        // process included, has a temporary file of its own.
+        static auto writers   = std::atomic<std::uint64_t>{ 0 };
+        auto        writer    = "." + std::to_string(writers.fetch_add(1, std::memory_order_relaxed));
+        auto        target    = file_for(hash(fields));
+        auto        temporary = fs::path{ target }.concat("." + std::to_string(::getpid()) + writer);
+        {
+            auto file = std::ofstream{ temporary, std::ios::binary | std::ios::trunc };
+            file << fields.size() << ' ' << result.status << ' ' << result.out.size() << ' ' << result.err.size();
+            file << '\n' << fields << result.out << result.err;
+        }
+        fs::rename(temporary, target);
+    }
+
+    // The key fields one after the other, each ended by a NUL, which no argument or variable can contain, so
+    // ("ab", "c") and ("a", "bc") differ.
+    auto fields(
+        const fs::path&                    exe,
+        const sys::is_arguments_type auto& args,
+        const env::environment::optional&  environment,
+        const std::optional<fs::path>&     cwd) const -> std::string
+    {
+        auto all   = std::string{};
+        auto field = [&all](std::string_view bytes) {
+            all += bytes;
+            all += '\0';
+        };
+        auto resolved = resolve(exe);
+        field(resolved.string());
+        auto error    = std::error_code{};
+        auto modified = fs::last_write_time(resolved, error);
+        if (!error) {
+            field(std::to_string(modified.time_since_epoch().count()));
+        }
+        const auto arguments = sys::Args{ args };
+        for (const auto& arg : arguments.data_source) {
+            field(arg);
+        }
+        field(cwd.value_or(fs::current_path()).string());
+        for (const auto& name : key_variables) {
+            auto value = std::optional<std::string>{};
+            if (environment.has_value()) {
+                value = environment.value().value_for(name);
+            } else if (const auto *system = std::getenv(name.c_str()); system != nullptr) {
+                value = system;
+            }
+            field(name);
+            field(value.has_value() ? "=" + value.value() : "");
+        }
+        return all;
+    }
+
+public:
+    explicit execution_cache(std::vector<std::string> variables = {}, std::optional<fs::path> directory = {})
+        : key_variables{ std::move(variables) }
+        , store{ std::move(directory) }
+    {
+    }
+
+    auto key(
+        const fs::path&                    exe,
+        const sys::is_arguments_type auto& args,
+        const env::environment::optional&  environment = {},
+        const std::optional<fs::path>&     cwd         = {}) const -> std::uint64_t
+    {
+        return hash(fields(exe, args, environment, cwd));
+    }
+
+    /// The stored result of the command, it is executed only when nothing is stored for its key.
+    auto run(
+        fs::path                           exe,
+        const sys::is_arguments_type auto& args,
+        env::environment::optional         environment = {},
+        std::optional<fs::path>            cwd         = {},
+        std::source_location               source      = std::source_location::current()) -> const execution_result&
+    {
+        auto id = fields(exe, args, environment, cwd);
+        if (auto found = entries.find(id); found != std::end(entries)) {
+            ++hit_count;
+            return found->second;
+        }
+        if (auto stored = load(id); stored.has_value()) {
+            ++hit_count;
+            return entries.emplace(std::move(id), std::move(stored).value()).first->second;
+        }
+
+        ++miss_count;
+        auto result  = execution_result{};
+        auto handler = execution(io_set::OUT | io_set::ERR);
+        handler.execute(std::move(exe), args, std::move(environment), std::move(cwd), source);
+        result.status = handler.stream(std::array<std::string_view, 0>{}, [&result](std_io io, std::string line) {
+            (io == std_io::OUT ? result.out : result.err) += line;
+        });
+        save(id, result);
+        return entries.emplace(std::move(id), std::move(result)).first->second;
+    }
+
+    auto run(
+        fs::path                   exe,
+        env::environment::optional environment = {},
+        std::optional<fs::path>    cwd         = {},
+        std::source_location       source      = std::source_location::current()) -> const execution_result&
+    {
+        return run(std::move(exe), std::array<std::string, 0>{}, std::move(environment), std::move(cwd), source);
+    }
+
+    /// Forgets the results kept in memory, the on-disk store is left alone.
+    void clear() { entries.clear(); }
+
+    auto hits() const noexcept { return hit_count; }
+
+    auto misses() const noexcept { return miss_count; }
+};
+
+}
+
+#endif
@@ -8,12 +8,18 @@
 #include "system.hpp"
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
 #include <expected>
 #include <iostream>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <system_error>
 #include <utility>
 
@@ -95,10 +101,41 @@ pipe_error_category()
     return instance;
 }
 
+/// Moves bytes of `buffer` into `partial_line` until it ends with a newline and returns that line. The empty buffer is
+/// refilled by `load` while `can_load()` holds, an incomplete last line is only returned once `open()` does not.
+template<typename BUFFER_T>
+auto
+take_line(
+    std::string&         partial_line,
+    BUFFER_T&            buffer,
+    std::invocable auto  can_load,
+    std::invocable auto  load,
+    std::invocable auto  open) -> std::expected<std::string, std::error_code>
+{
+    while (partial_line.empty() || partial_line.back() != '\n') {
+        if (!buffer.has_data() && can_load()) {
+            load();
+        } else if (!buffer.has_data()) {
+            // Keep incomplete lines for the next call, unless nothing else can come.
+            if (open() || partial_line.empty()) {
+                return std::unexpected(std::error_code{ 1, pipe_error_category() });
+            }
+            break;
+        }
+
+        if (buffer.has_data()) {
+            partial_line += buffer.unload_line();
+        }
+    }
+    return std::exchange(partial_line, std::string{});
+}
+
 template<std::size_t BUFFER_SIZE = (4 * KB)>
 struct pipe_base
 {
-    using buffer_type = vb::buffer_type<BUFFER_SIZE>;
+    using buffer_type   = vb::buffer_type<BUFFER_SIZE>;
+    using expect_string = std::expected<std::string, std::error_code>;
+    using unexpected    = std::unexpected<std::error_code>;
     using enum io_direction;
 
 private:
@@ -117,6 +154,27 @@ private:
 
     std::array<int, 2> file_descriptors{ -1, -1 };
     buffer_type        buffer;
+    std::string        partial_line{};
+    int                tee_target{ -1 };
+    bool               tee_splice{ false };
+
+    std::optional<std::chrono::steady_clock::time_point> first_data{};
+
+    // Copies up to `size` pending bytes to a pipe tee target without consuming them, falls back to writes on error.
+    auto tee_ahead(std::size_t size) -> long
+    {
+#ifdef __linux__
+        auto teed = sys::tee(file_descriptors[index(READ)], tee_target, size, 0U);
+        if (teed < 0) {
+            tee_splice = false;
+        }
+        return teed;
+#else
+        static_cast<void>(size);
+        tee_splice = false;
+        return -1;
+#endif
+    }
 
     auto buffer_load(char *data, std::size_t size) -> long
     {
@@ -130,7 +188,20 @@ private:
             return read_size;
         }
 
+        // Reading no more than the kernel copied keeps both streams identical.
+        auto teed = tee_splice ? tee_ahead(size) : -1;
+        if (teed > 0) {
+            size = static_cast<std::size_t>(teed);
+        }
+
         read_size = sys::read(file_descriptors[index(READ)], data, size);
+        if (read_size > 0 && !first_data.has_value()) {
+            first_data = std::chrono::steady_clock::now();
+        }
+
+        if (read_size > 0 && tee_target != -1 && teed <= 0) {
+            sys::write_all(tee_target, std::string_view{ data, static_cast<std::size_t>(read_size) });
+        }
 
         if (read_size == 0) {
             close<READ>();
@@ -175,14 +246,23 @@ private:
         }
 
         using namespace std::literals;
-        return (sys::poll(0ms, sys::poll_arg{ .fd = file_descriptors[index(READ)], .events = POLLIN })[0] & POLLIN) !=
-               0;
+        // A hang up means that the next read returns the end of file.
+        return (sys::poll(0ms, sys::poll_arg{ .fd = file_descriptors[index(READ)], .events = POLLIN })[0] &
+                (POLLIN | POLLHUP)) != 0;
     }
 
-public:
-    using expect_string = std::expected<std::string, std::error_code>;
-    using unexpected    = std::unexpected<std::error_code>;
+    // The next complete line, the incomplete last one once the pipe is closed. Reads only when `load` is set.
+    auto next_line(bool load) -> expect_string
+    {
+        return take_line(
+            partial_line,
+            buffer,
+            [this, load] { return load && can_be_read(); },
+            [this] { buffer_load(); },
+            [this] { return file_descriptors[index(READ)] != -1; });
+    }
 
+public:
     constexpr int get_fd(io_direction dir) const
     {
         if (dir == NONE || dir == BOTH) {
@@ -273,15 +353,49 @@ public:
 
     bool closed() const
     {
-        if (buffer.has_data()) {
+        if (buffer.has_data() || !partial_line.empty()) {
             return false;
         }
-        return (is<READ>() && file_descriptors[index(READ)] == -1) &&
-               (is<WRITE>() && file_descriptors[index(WRITE)] == -1);
+        return file_descriptors[index(READ)] == -1 && file_descriptors[index(WRITE)] == -1;
     }
 
     bool has_data() const { return buffer.has_data() || can_be_read(); }
 
+    /// Raw bytes, buffered ones first, 0 when nothing can be read right now.
+    auto read_some(std::span<char> out) -> std::size_t
+    {
+        if (out.empty()) {
+            // A read of 0 bytes also returns 0, which would be taken for the end of file.
+            return 0;
+        }
+        if (!partial_line.empty()) {
+            auto size = std::min(out.size(), partial_line.size());
+            std::copy_n(partial_line.begin(), size, out.begin());
+            partial_line.erase(0, size);
+            return size;
+        }
+        if (buffer.has_data()) {
+            return buffer.unload(out);
+        }
+        if (!can_be_read()) {
+            return 0;
+        }
+        return static_cast<std::size_t>(std::max(buffer_load(out.data(), out.size()), 0L));
+    }
+
+    /// When the first read of this pipe got some bytes.
+    auto first_read() const noexcept -> const std::optional<std::chrono::steady_clock::time_point>&
+    {
+        return first_data;
+    }
+
+    /// Everything read from now on is also written to `fd`, by tee(2) when `fd` is a pipe.
+    void tee(int fd)
+    {
+        tee_target = fd;
+        tee_splice = fd != -1 && sys::is_fifo(fd);
+    }
+
     template<can_be_outstreamed... DATA_Ts>
     auto operator()(DATA_Ts... data)
     {
@@ -293,23 +407,14 @@ public:
         }
     }
 
-    expect_string operator()()
-    {
-        auto result = std::string();
+    expect_string operator()() { return next_line(true); }
 
-        while(result.size() == 0 || result.back() != '\n') {
-            if (!buffer.has_data() && can_be_read()) {
-                buffer_load();
-            } else if (!buffer.has_data()) {
-                return unexpected(std::error_code{ 1, pipe_error_category() });
-            }
+    /// Reads once into the buffer without polling first, for callers that already know the pipe is readable.
+    /// Returns the bytes read, 0 at the end of file, which also closes the read end.
+    auto fill() -> long { return buffer_load(); }
 
-            if (buffer.has_data()) {
-                result += buffer.unload_line();
-            }
-        }
-        return expect_string{ result };
-    }
+    /// Like the call operator but only takes what is already buffered, never touching the descriptor.
+    expect_string buffered_line() { return next_line(false); }
 
     pipe_base()
         : file_descriptors(sys::pipe())
@@ -320,6 +425,9 @@ public:
 
     pipe_base(pipe_base&& other) noexcept
         : file_descriptors{ other.file_descriptors }
+        , tee_target{ other.tee_target }
+        , tee_splice{ other.tee_splice }
+        , first_data{ other.first_data }
     {
         other.file_descriptors = { -1, -1 };
     }
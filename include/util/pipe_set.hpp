@@ -0,0 +1,177 @@
+// pipe_set.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_PIPE_SET_HPP
+#define INCLUDED_PIPE_SET_HPP
+
+#include "pipe.hpp"
+#include "system.hpp"
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+
+namespace vb {
+
+/// Reads many pipes from one thread: a single epoll set watches all of them and each wakeup only touches the pipes
+/// that are ready, reading them once and handing every complete line to the callback of its pipe.
+class pipe_set
+{
+public:
+    using line_callback = std::function<void(std::string)>;
+    using end_callback  = std::function<void()>;
+
+private:
+    static constexpr int MAX_EVENTS = 256;
+
+    static constexpr auto epoll_ctl =
+        sys::throw_on_error<sys::call_type::ERRNO, int, int, int, epoll_event *>("epoll_ctl", ::epoll_ctl);
+
+    // The set watches its own duplicate of the read end. A registration lives as long as any descriptor of the pipe
+    // does, children being spawned hold one for a moment, so it has to be removed before the pipe closes its end.
+    struct entry
+    {
+        pipe         *source{ nullptr };
+        int           watched_fd{ -1 };
+        line_callback on_line{};
+        end_callback  on_end{};
+    };
+
+    int                                     epoll_fd;
+    std::unordered_map<const pipe *, entry> entries{};
+    std::vector<const pipe *>               retired{};
+    bool                                    dispatching{ false };
+
+    void deliver(entry& watched)
+    {
+        auto& source = *watched.source;
+        source.fill();
+        for (auto line = source.buffered_line(); line; line = source.buffered_line()) {
+            watched.on_line(std::move(line).value());
+            if (watched.source == nullptr) {
+                return;
+            }
+        }
+        if (source.get_fd(io_direction::READ) == -1) {
+            auto on_end = std::move(watched.on_end);
+            remove(source);
+            if (on_end) {
+                on_end();
+            }
+        }
+    }
+
+    void forget_retired()
+    {
+        for (const auto *source : std::exchange(retired, {})) {
+            entries.erase(source);
+        }
+    }
+
+public:
+    pipe_set()
+        : epoll_fd{ sys::epoll_create1(EPOLL_CLOEXEC) }
+    {
+    }
+
+    pipe_set(const pipe_set&)            = delete;
+    pipe_set(pipe_set&&)                 = delete;
+    pipe_set& operator=(const pipe_set&) = delete;
+    pipe_set& operator=(pipe_set&&)      = delete;
+
+    ~pipe_set()
+    {
+        for (auto& [source, watched] : entries) {
+            if (watched.watched_fd != -1) {
+                ::close(watched.watched_fd);
+            }
+        }
+        ::close(epoll_fd);
+    }
+
+    /// Watches the read end of `source`, which has to outlive its registration. `on_end` runs once the pipe is
+    /// closed and all its lines were delivered, the pipe is removed from the set right before.
+    void add(pipe& source, line_callback on_line, end_callback on_end = {})
+    {
+        // Entries are nodes of the map, the address given to epoll stays valid when others are added.
+        auto& watched   = entries[&source];
+        watched.on_line = std::move(on_line);
+        watched.on_end  = std::move(on_end);
+        if (watched.source == nullptr) {
+            watched.source     = &source;
+            watched.watched_fd = sys::fcntl(source.get_fd(io_direction::READ), F_DUPFD_CLOEXEC, 0);
+            auto event         = epoll_event{ .events = EPOLLIN, .data = { .ptr = &watched } };
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, watched.watched_fd, &event);
+            std::erase(retired, &source);
+        }
+    }
+
+    /// Stops watching `source`, also from one of the callbacks.
+    void remove(pipe& source)
+    {
+        auto found = entries.find(&source);
+        if (found == std::end(entries) || found->second.source == nullptr) {
+            return;
+        }
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, found->second.watched_fd, nullptr);
+        ::close(std::exchange(found->second.watched_fd, -1));
+        found->second.source = nullptr;
+        retired.push_back(&source);
+        if (!dispatching) {
+            forget_retired();
+        }
+    }
+
+    /// Waits at most `timeout` for ready pipes and delivers their lines, returns how many pipes were ready.
+    auto poll(std::chrono::milliseconds timeout = std::chrono::milliseconds{ -1 }) -> std::size_t
+    {
+        auto events = std::array<epoll_event, MAX_EVENTS>{};
+        auto ready  = sys::epoll_wait(epoll_fd, events.data(), MAX_EVENTS, static_cast<int>(timeout.count()));
+        auto count  = static_cast<std::size_t>(std::max(ready, 0));
+        dispatching = true;
+        try {
+            for (auto& event : std::span{ events }.first(count)) {
+                if (auto *watched = static_cast<entry *>(event.data.ptr); watched->source != nullptr) {
+                    deliver(*watched);
+                }
+            }
+        } catch (...) {
+            dispatching = false;
+            forget_retired();
+            throw;
+        }
+        dispatching = false;
+        forget_retired();
+        return count;
+    }
+
+    /// Delivers lines until every pipe has ended or was removed.
+    void run()
+    {
+        while (!empty()) {
+            poll();
+        }
+    }
+
+    auto size() const noexcept -> std::size_t { return entries.size() - retired.size(); }
+
+    auto empty() const noexcept -> bool { return size() == 0; }
+};
+
+}
+
+#endif
+
+#endif
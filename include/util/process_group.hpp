@@ -0,0 +1,118 @@
+// process_group.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_PROCESS_GROUP_HPP
+#define INCLUDED_PROCESS_GROUP_HPP
+
+#include "execution.hpp"
+#include "system.hpp"
+#include <signal.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+/// Executions sharing one process group, which their own children join too unless they move elsewhere.
+/// A signal reaches the whole tree with one killpg and the members are reaped by waits on the group.
+class process_group
+{
+    std::vector<std::unique_ptr<execution>> members{};
+    pid_t                                   group{ -1 };
+
+    auto member_for(pid_t pid) -> execution *
+    {
+        auto found = std::ranges::find(members, pid, [](const auto& member) { return member->get_pid(); });
+        return found != std::end(members) ? found->get() : nullptr;
+    }
+
+    void reap(int option)
+    {
+        if (group == -1) {
+            return;
+        }
+        while (auto child = sys::wait_group(group, option)) {
+            if (auto *member = member_for(child.value().pid); member != nullptr) {
+                member->reaped(child.value().status, child.value().usage);
+            }
+        }
+        // Its id may name another group soon, which nothing here must signal or join.
+        if (running() == 0) {
+            group = -1;
+        }
+    }
+
+    auto running() const -> std::size_t
+    {
+        return static_cast<std::size_t>(
+            std::ranges::count_if(members, [](const auto& member) { return !member->current_status.has_value(); }));
+    }
+
+public:
+    process_group() = default;
+
+    process_group(const process_group&)            = delete;
+    process_group(process_group&&)                 = delete;
+    process_group& operator=(const process_group&) = delete;
+    process_group& operator=(process_group&&)      = delete;
+
+    /// Spawns a member with the arguments of `execution::execute`, the first one leads the group and names it.
+    /// Once every member has been reaped the group is forgotten, `signal` does nothing and the next member leads a
+    /// new one.
+    template<typename... ARGS_T>
+    auto execute(io_set redirections, ARGS_T&&... args) -> execution&
+    {
+        auto& member = *members.emplace_back(std::make_unique<execution>(redirections));
+        try {
+            member.process_group(group == -1 ? 0 : group);
+            member.execute(std::forward<ARGS_T>(args)...);
+        } catch (...) {
+            members.pop_back();
+            throw;
+        }
+        if (group == -1) {
+            group = member.get_pid();
+        }
+        return member;
+    }
+
+    /// Sends `sig` to every process of the group, grandchildren included, with a single call.
+    void signal(int sig = SIGTERM)
+    {
+        if (group != -1) {
+            sys::killpg(group, sig);
+        }
+    }
+
+    /// Reaps every member still running and returns the statuses in the order the members were added.
+    auto wait() -> std::vector<int>
+    {
+        reap(0);
+        auto statuses = std::vector<int>{};
+        statuses.reserve(members.size());
+        for (auto& member : members) {
+            statuses.push_back(member->wait());
+        }
+        group = -1;
+        return statuses;
+    }
+
+    /// Members that exited since the last call are reaped without blocking, returns how many are still running.
+    auto poll() -> std::size_t
+    {
+        reap(WNOHANG);
+        return running();
+    }
+
+    auto id() const noexcept { return group; }
+
+    auto size() const noexcept { return members.size(); }
+
+    auto operator[](std::size_t index) -> execution& { return *members.at(index); }
+};
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+// reactor.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_REACTOR_HPP
+#define INCLUDED_REACTOR_HPP
+
+#include "system.hpp"
+#include "task.hpp"
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+#ifdef __linux__
+
+namespace vb {
+
+/// Single threaded epoll loop, resumes coroutines when their descriptor is ready or their timer expires.
+class reactor
+{
+public:
+    using clock      = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+
+private:
+    static constexpr int MAX_EVENTS = 256;
+
+    struct io_awaiter
+    {
+        reactor&                self; // NOLINT: cppcoreguidelines-avoid-const-or-ref-data-members
+        int                     fd;
+        std::uint32_t           events;
+        std::uint32_t           ready{ 0 };
+        std::coroutine_handle<> waiting{};
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            waiting = handle;
+            self.arm(*this);
+        }
+
+        std::uint32_t await_resume() const noexcept { return ready; }
+    };
+
+    struct timer_awaiter
+    {
+        reactor&   self; // NOLINT: cppcoreguidelines-avoid-const-or-ref-data-members
+        time_point when;
+
+        bool await_ready() const noexcept { return when <= clock::now(); }
+
+        void await_suspend(std::coroutine_handle<> handle) { self.timers.emplace(when, handle); }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct detached
+    {
+        struct promise_type
+        {
+            reactor& self; // NOLINT: cppcoreguidelines-avoid-const-or-ref-data-members
+
+            promise_type(reactor& owner, task<void>&)
+                : self{ owner }
+            {
+            }
+
+            detached get_return_object()
+            {
+                self.supervised.insert(std::coroutine_handle<promise_type>::from_promise(*this).address());
+                return {};
+            }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            std::suspend_never final_suspend() noexcept
+            {
+                self.supervised.erase(std::coroutine_handle<promise_type>::from_promise(*this).address());
+                return {};
+            }
+
+            void return_void() noexcept {}
+
+            void unhandled_exception() noexcept { self.failure = std::current_exception(); }
+        };
+    };
+
+    static constexpr auto epoll_ctl_add =
+        sys::throw_on_error<sys::call_type::ERRNO, int, int, int, epoll_event *>("epoll_ctl", ::epoll_ctl);
+    static constexpr auto epoll_ctl_modify = sys::throw_on_error<sys::call_type::ERRNO, int, int, int, epoll_event *>(
+        "epoll_ctl",
+        ::epoll_ctl,
+        std::array{ ENOENT });
+
+    int                                                epoll_fd;
+    std::size_t                                        armed{ 0 };
+    std::multimap<time_point, std::coroutine_handle<>> timers{};
+    std::unordered_set<void *>                         supervised{};
+    std::exception_ptr                                 failure{};
+
+    void arm(io_awaiter& awaiter)
+    {
+        auto event = epoll_event{ .events = awaiter.events | EPOLLONESHOT, .data = { .ptr = &awaiter } };
+        // One shot registrations stay in the set disabled, so rearming is usually a modification.
+        if (epoll_ctl_modify(epoll_fd, EPOLL_CTL_MOD, awaiter.fd, &event) == -1) {
+            epoll_ctl_add(epoll_fd, EPOLL_CTL_ADD, awaiter.fd, &event);
+        }
+        ++armed;
+    }
+
+    int next_timeout() const
+    {
+        if (timers.empty()) {
+            return -1;
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first - clock::now());
+        return static_cast<int>(std::max(wait.count(), std::chrono::milliseconds::rep{ 0 }));
+    }
+
+    void resume_timers()
+    {
+        const auto now = clock::now();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            auto handle = timers.begin()->second;
+            timers.erase(timers.begin());
+            handle.resume();
+        }
+    }
+
+    void rethrow()
+    {
+        if (failure) {
+            std::rethrow_exception(std::exchange(failure, nullptr));
+        }
+    }
+
+    detached supervise(task<void> job) { co_await job; }
+
+public:
+    reactor()
+        : epoll_fd{ sys::epoll_create1(EPOLL_CLOEXEC) }
+    {
+    }
+
+    reactor(const reactor&)            = delete;
+    reactor(reactor&&)                 = delete;
+    reactor& operator=(const reactor&) = delete;
+    reactor& operator=(reactor&&)      = delete;
+
+    ~reactor()
+    {
+        for (auto *frame : std::exchange(supervised, {})) {
+            std::coroutine_handle<>::from_address(frame).destroy();
+        }
+        ::close(epoll_fd);
+    }
+
+    auto readable(int fd) -> io_awaiter { return io_awaiter{ .self = *this, .fd = fd, .events = EPOLLIN }; }
+
+    auto writable(int fd) -> io_awaiter { return io_awaiter{ .self = *this, .fd = fd, .events = EPOLLOUT }; }
+
+    auto sleep_until(time_point when) -> timer_awaiter { return timer_awaiter{ .self = *this, .when = when }; }
+
+    auto sleep_for(clock::duration delay) -> timer_awaiter { return sleep_until(clock::now() + delay); }
+
+    /// Runs `job` up to its first suspension, the reactor owns it from there on.
+    void spawn(task<void> job)
+    {
+        supervise(std::move(job));
+        rethrow();
+    }
+
+    auto pending() const noexcept { return supervised.size(); }
+
+    /// Waits at most `timeout` milliseconds for events, resuming everything that is ready.
+    void run_once(int timeout)
+    {
+        auto events = std::array<epoll_event, MAX_EVENTS>{};
+        auto count  = sys::epoll_wait(epoll_fd, events.data(), MAX_EVENTS, timeout);
+        for (auto& event : std::span{ events }.first(static_cast<std::size_t>(std::max(count, 0)))) {
+            auto *awaiter  = static_cast<io_awaiter *>(event.data.ptr);
+            awaiter->ready = event.events;
+            --armed;
+            awaiter->waiting.resume();
+        }
+        resume_timers();
+        rethrow();
+    }
+
+    void run()
+    {
+        while (!supervised.empty()) {
+            if (armed == 0 && timers.empty()) {
+                throw std::logic_error("reactor: tasks are suspended without waiting on the reactor");
+            }
+            run_once(next_timeout());
+        }
+    }
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,350 @@
+// shm_ring.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_SHM_RING_HPP
+#define INCLUDED_SHM_RING_HPP
+
+#include "buffer.hpp"
+#include "converters.hpp"
+#include "pipe.hpp"
+#include "system.hpp"
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <new>
+#include <optional>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__) && defined(SYS_futex)
+
+namespace vb {
+
+/// Single producer, single consumer byte ring in a memfd that a parent and a child both map, with the line API of
+/// `pipe`. Bytes move with plain copies, a futex call is only made when one side sleeps on the other. The child gets
+/// the descriptor through a `redirection::fd` onto one of its standard streams and maps it with `attach`. A side that
+/// waits notices when the process that attached, or the one that created the ring, exits. The creator also watches
+/// the process given to `peer` until another one attached.
+class shm_ring
+{
+public:
+    using expect_string = std::expected<std::string, std::error_code>;
+    using unexpected    = std::unexpected<std::error_code>;
+
+    static constexpr std::size_t DEFAULT_CAPACITY = 1 * MB;
+
+private:
+    // Checks of the other side's progress before sleeping on its futex.
+    static constexpr int SPIN_COUNT = 256;
+
+    // How long a sleep lasts before checking that the process on the other side still runs.
+    static constexpr auto LIVENESS_CHECK = std::chrono::milliseconds{ 100 };
+
+    // Each side writes its own cache line, the reader the tail and the writer all the rest.
+    struct header
+    {
+        alignas(64) std::atomic<std::uint64_t> head{ 0 };
+        std::atomic<std::uint32_t>             written{ 0 };
+        std::atomic<std::uint32_t>             writer_waiting{ 0 };
+        std::atomic<std::uint32_t>             finished{ 0 };
+        alignas(64) std::atomic<std::uint64_t> tail{ 0 };
+        std::atomic<std::uint32_t>             consumed{ 0 };
+        std::atomic<std::uint32_t>             reader_waiting{ 0 };
+        alignas(64) std::uint64_t              capacity{ 0 };
+        std::atomic<pid_t>                     creator{ 0 };
+        std::atomic<pid_t>                     attacher{ 0 };
+    };
+    static_assert(sizeof(header) <= sys::PAGE_SIZE);
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free);
+    static_assert(std::atomic<pid_t>::is_always_lock_free);
+
+    int         ring_fd{ -1 };
+    std::size_t mapped{ 0 };
+    header     *shared{ nullptr };
+    char       *data{ nullptr };
+    bool        attached{ false };
+    pid_t       expected_peer{ 0 };
+    std::string partial_line{};
+
+    // Maps the ring of `fd` and closes it on failure, a new ring is sized and initialized first.
+    shm_ring(int fd, std::size_t capacity, bool initialize, std::source_location source)
+        : ring_fd{ fd }
+        , mapped{ sys::PAGE_SIZE + capacity }
+        , attached{ !initialize }
+    {
+        try {
+            if (initialize) {
+                sys::ftruncate(fd, static_cast<off_t>(mapped), source);
+            }
+            auto *address = sys::map_shared(fd, mapped, source);
+            shared        = static_cast<header *>(address);
+            data          = static_cast<char *>(address) + sys::PAGE_SIZE;
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (initialize) {
+            new (shared) header{};
+            shared->capacity = capacity;
+        }
+        (attached ? shared->attacher : shared->creator).store(::getpid());
+    }
+
+    auto mask() const noexcept { return shared->capacity - 1; }
+
+    auto readable() const noexcept { return shared->head.load() - shared->tail.load(); }
+
+    auto writable() const noexcept { return shared->capacity - (shared->head.load() - shared->tail.load()); }
+
+    // Whether the process on the other side still runs, an unknown one is assumed to. One that exited but was not
+    // reaped yet is gone too.
+    auto peer_alive() const -> bool
+    {
+        auto peer = (attached ? shared->creator : shared->attacher).load();
+        if (peer == 0 && !attached) {
+            peer = expected_peer;
+        }
+        if (peer <= 0 || peer == ::getpid()) {
+            return true;
+        }
+#ifdef SYS_pidfd_open
+        if (auto exit = sys::pidfd_open(peer); exit != -1) {
+            using namespace std::literals;
+            auto exited = (sys::poll(0ms, sys::poll_arg{ .fd = exit, .events = POLLIN })[0] & POLLIN) != 0;
+            ::close(exit);
+            return !exited;
+        }
+        if (errno == ESRCH) {
+            return false;
+        }
+#endif
+        return ::kill(peer, 0) == 0 || errno != ESRCH;
+    }
+
+    // Sleeps on `word` until `ready` holds, after telling the other side through `waiting` that it has to wake us.
+    // False when the other side exited meanwhile.
+    template<std::invocable READY_T>
+    auto wait_until(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiting, READY_T ready) const -> bool
+    {
+        for (auto spin = 0; spin < SPIN_COUNT; ++spin) {
+            if (ready()) {
+                return true;
+            }
+        }
+        waiting.store(1);
+        auto alive = true;
+        while (true) {
+            auto seen = word.load();
+            if (ready()) {
+                break;
+            }
+            if (!sys::futex_wait(word, seen, LIVENESS_CHECK) && !ready() && !peer_alive()) {
+                alive = false;
+                break;
+            }
+        }
+        waiting.store(0);
+        return alive;
+    }
+
+    // Waits for bytes or the end, a writer that died without `close_write` ends the stream all the same.
+    void wait_readable()
+    {
+        auto ready = [this] { return readable() != 0 || shared->finished.load() != 0; };
+        if (!wait_until(shared->written, shared->reader_waiting, ready)) {
+            shared->finished.store(1);
+        }
+    }
+
+    static void wake(std::atomic<std::uint32_t>& word, const std::atomic<std::uint32_t>& waiting)
+    {
+        if (waiting.load() != 0) {
+            word.fetch_add(1);
+            sys::futex_wake(word);
+        }
+    }
+
+    void consume(std::size_t size)
+    {
+        shared->tail.store(shared->tail.load(std::memory_order_relaxed) + size);
+        wake(shared->consumed, shared->writer_waiting);
+    }
+
+    // The readable bytes from the tail on, in two parts when they wrap around the end of the ring.
+    auto readable_parts() const -> std::array<std::string_view, 2>
+    {
+        auto available = readable();
+        auto offset    = shared->tail.load(std::memory_order_relaxed) & mask();
+        auto first     = std::min(available, shared->capacity - offset);
+        return { std::string_view{ data + offset, first }, std::string_view{ data, available - first } };
+    }
+
+public:
+    /// A new ring of at least `capacity` bytes, rounded up to a power of two.
+    static auto create(
+        std::size_t          capacity = DEFAULT_CAPACITY,
+        std::source_location source   = std::source_location::current()) -> shm_ring
+    {
+        auto size = std::bit_ceil(std::max(capacity, sys::PAGE_SIZE));
+        return shm_ring{ sys::memfd_create("vb_shm_ring", MFD_CLOEXEC, source), size, true, source };
+    }
+
+    /// Maps the ring created by the other side, `fd` is now owned by the result.
+    static auto attach(int fd, std::source_location source = std::source_location::current()) -> shm_ring
+    {
+        struct stat status{};
+        if (::fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) <= sys::PAGE_SIZE) {
+            throw std::runtime_error("shm_ring: descriptor " + std::to_string(fd) + " is not a ring");
+        }
+        return shm_ring{ fd, static_cast<std::size_t>(status.st_size) - sys::PAGE_SIZE, false, source };
+    }
+
+    shm_ring(const shm_ring&)            = delete;
+    shm_ring(shm_ring&&)                 = delete;
+    shm_ring& operator=(const shm_ring&) = delete;
+    shm_ring& operator=(shm_ring&&)      = delete;
+
+    ~shm_ring()
+    {
+        ::munmap(shared, mapped);
+        ::close(ring_fd);
+    }
+
+    auto get_fd() const noexcept { return ring_fd; }
+
+    /// The process expected to attach, usually the child just spawned. Until it attaches, a wait of the creator ends
+    /// when that process exits instead of lasting forever.
+    void peer(pid_t pid) noexcept { expected_peer = pid; }
+
+    auto capacity() const noexcept -> std::size_t { return shared->capacity; }
+
+    /// Copies all of `bytes` into the ring, sleeping whenever it is full.
+    void write(std::string_view bytes)
+    {
+        while (!bytes.empty()) {
+            if (writable() == 0 &&
+                !wait_until(shared->consumed, shared->writer_waiting, [this] { return writable() != 0; })) {
+                throw std::runtime_error("shm_ring: the reader is gone");
+            }
+            auto head   = shared->head.load(std::memory_order_relaxed);
+            auto size   = std::min<std::uint64_t>(bytes.size(), writable());
+            auto offset = head & mask();
+            auto first  = std::min(size, shared->capacity - offset);
+            std::memcpy(data + offset, bytes.data(), first);
+            std::memcpy(data, bytes.data() + first, size - first);
+            shared->head.store(head + size);
+            wake(shared->written, shared->reader_waiting);
+            bytes.remove_prefix(size);
+        }
+    }
+
+    template<can_be_outstreamed... DATA_Ts>
+    auto operator()(DATA_Ts... items)
+    {
+        for (auto str : std::array{ to_string(items)... }) {
+            if (str.empty() || str.back() != '\n') {
+                str += '\n';
+            }
+            write(str);
+        }
+    }
+
+    /// Nothing more is written, the reader gets the end of file once it has read everything.
+    void close_write()
+    {
+        shared->finished.store(1);
+        shared->written.fetch_add(1);
+        sys::futex_wake(shared->written);
+    }
+
+    bool closed() const { return partial_line.empty() && shared->finished.load() != 0 && readable() == 0; }
+
+    bool has_data() const { return !partial_line.empty() || readable() != 0; }
+
+    /// Raw bytes, 0 when nothing can be read right now.
+    auto read_some(std::span<char> out) -> std::size_t
+    {
+        if (!partial_line.empty()) {
+            auto size = std::min(out.size(), partial_line.size());
+            std::copy_n(partial_line.begin(), size, out.begin());
+            partial_line.erase(0, size);
+            return size;
+        }
+        auto size = std::size_t{ 0 };
+        for (auto part : readable_parts()) {
+            auto taken = std::min(part.size(), out.size() - size);
+            std::copy_n(part.data(), taken, out.data() + size);
+            size += taken;
+        }
+        consume(size);
+        return size;
+    }
+
+    /// Blocks until some bytes can be read, 0 only at the end of file.
+    auto read(std::span<char> out) -> std::size_t
+    {
+        if (!has_data()) {
+            wait_readable();
+        }
+        return read_some(out);
+    }
+
+    expect_string operator()()
+    {
+        // Checked before the bytes are, so that all of them are seen once the writer is done.
+        auto done  = shared->finished.load() != 0;
+        auto taken = std::size_t{ 0 };
+        auto found = false;
+        for (auto part : readable_parts()) {
+            auto end  = part.find('\n');
+            found     = end != std::string_view::npos;
+            auto line = part.substr(0, found ? end + 1 : part.size());
+            partial_line.append(line);
+            taken += line.size();
+            if (found) {
+                break;
+            }
+        }
+        consume(taken);
+        if (found || (done && readable() == 0 && !partial_line.empty())) {
+            return expect_string{ std::exchange(partial_line, std::string{}) };
+        }
+        return unexpected(std::error_code{ 1, pipe_error_category() });
+    }
+
+    /// Blocks until the next line, nothing once the writer is done and everything was read.
+    auto next_line() -> std::optional<std::string>
+    {
+        while (true) {
+            if (auto line = (*this)(); line) {
+                return std::move(line).value();
+            }
+            if (shared->finished.load() != 0 && readable() == 0) {
+                return std::nullopt;
+            }
+            wait_readable();
+        }
+    }
+};
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+// socket_channel.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_SOCKET_CHANNEL_HPP
+#define INCLUDED_SOCKET_CHANNEL_HPP
+
+#include "buffer.hpp"
+#include "converters.hpp"
+#include "pipe.hpp"
+#include "system.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <source_location>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace vb {
+
+/// One end of a unix domain socket pair, a bidirectional alternative to `pipe` with the same line API. The other end
+/// can serve as both stdin and stdout of a child through `execution::redirect`. With SOCK_SEQPACKET every send is one
+/// message, and descriptors can travel along with the data.
+template<std::size_t BUFFER_SIZE = (4 * KB)>
+class socket_channel_base
+{
+public:
+    using buffer_type   = vb::buffer_type<BUFFER_SIZE>;
+    using expect_string = std::expected<std::string, std::error_code>;
+    using unexpected    = std::unexpected<std::error_code>;
+
+    // Most descriptors `receive` takes from one message.
+    static constexpr std::size_t MAX_FDS = 64;
+
+    struct message
+    {
+        std::size_t      size{ 0 };
+        std::vector<int> fds{};
+    };
+
+private:
+#ifdef MSG_NOSIGNAL
+    // A peer that is gone fails the send with EPIPE instead of raising SIGPIPE.
+    static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    static constexpr int SEND_FLAGS = 0;
+#endif
+#ifdef MSG_CMSG_CLOEXEC
+    static constexpr int RECEIVE_FLAGS = MSG_CMSG_CLOEXEC;
+#else
+    static constexpr int RECEIVE_FLAGS = 0;
+#endif
+
+    int         socket_fd{ -1 };
+    buffer_type buffer;
+    std::string partial_line{};
+    bool        end_of_file{ false };
+
+    // Reads into `data`, the descriptors that came along are kept in `fds`. Throws when part of the message is lost.
+    auto transfer(std::span<char> data, std::vector<int> *fds) -> long
+    {
+        if (socket_fd == -1 || end_of_file) {
+            return 0;
+        }
+        alignas(::cmsghdr) auto control = std::array<char, CMSG_SPACE(MAX_FDS * sizeof(int))>{};
+
+        auto vector           = ::iovec{ .iov_base = data.data(), .iov_len = data.size() };
+        auto header           = ::msghdr{};
+        header.msg_iov        = &vector;
+        header.msg_iovlen     = 1;
+        header.msg_control    = fds != nullptr ? control.data() : nullptr;
+        header.msg_controllen = fds != nullptr ? control.size() : 0;
+
+        auto size = sys::recvmsg(socket_fd, &header, fds != nullptr ? RECEIVE_FLAGS : 0);
+        if (size < 0) {
+            return 0;
+        }
+        if (size == 0 && !data.empty()) {
+            end_of_file = true;
+        }
+        if (fds != nullptr) {
+            for (auto *part = CMSG_FIRSTHDR(&header); part != nullptr; part = CMSG_NXTHDR(&header, part)) {
+                if (part->cmsg_level != SOL_SOCKET || part->cmsg_type != SCM_RIGHTS) {
+                    continue;
+                }
+                auto count = (part->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                auto first = fds->size();
+                fds->resize(first + count);
+                std::memcpy(fds->data() + first, CMSG_DATA(part), count * sizeof(int));
+            }
+        }
+        if ((header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+            if (fds != nullptr) {
+                std::ranges::for_each(std::exchange(*fds, {}), ::close);
+            }
+            if ((header.msg_flags & MSG_TRUNC) != 0) {
+                throw std::runtime_error("socket_channel: message cut to " + std::to_string(size) + " bytes");
+            }
+            throw std::runtime_error(
+                fds != nullptr ? "socket_channel: message with more than MAX_FDS descriptors"
+                               : "socket_channel: descriptors sent to a line read");
+        }
+        return size;
+    }
+
+    auto buffer_load() -> long
+    {
+        return buffer.load([this](char *data, std::size_t size) { return transfer({ data, size }, nullptr); });
+    }
+
+    bool can_be_read() const
+    {
+        if (socket_fd == -1 || end_of_file) {
+            return false;
+        }
+        using namespace std::literals;
+        return (sys::poll(0ms, sys::poll_arg{ .fd = socket_fd, .events = POLLIN })[0] & (POLLIN | POLLHUP)) != 0;
+    }
+
+public:
+    /// Takes ownership of `fd`, a connected socket.
+    explicit socket_channel_base(int fd)
+        : socket_fd{ fd }
+    {
+    }
+
+    socket_channel_base(const socket_channel_base&)            = delete;
+    socket_channel_base(socket_channel_base&&)                 = delete;
+    socket_channel_base& operator=(const socket_channel_base&) = delete;
+    socket_channel_base& operator=(socket_channel_base&&)      = delete;
+
+    ~socket_channel_base() { close(); }
+
+    auto get_fd() const noexcept { return socket_fd; }
+
+    void close()
+    {
+        if (socket_fd != -1) {
+            ::close(socket_fd);
+            socket_fd = -1;
+        }
+    }
+
+    /// The peer reads the end of file once it consumed what was sent, it can still answer.
+    void shutdown_write() { sys::shutdown(socket_fd, SHUT_WR); }
+
+    bool closed() const
+    {
+        if (buffer.has_data() || !partial_line.empty()) {
+            return false;
+        }
+        return socket_fd == -1 || end_of_file;
+    }
+
+    bool has_data() const { return buffer.has_data() || can_be_read(); }
+
+    /// Sends all of `data`, the first part of it with copies of `fds` that the receiver gets as new descriptors.
+    void send(std::string_view data, std::span<const int> fds = {})
+    {
+        if (data.empty() && !fds.empty()) {
+            throw std::invalid_argument("socket_channel: descriptors need at least one byte of data");
+        }
+        auto control = std::vector<char>(fds.empty() ? 0 : CMSG_SPACE(fds.size_bytes()));
+        while (!data.empty()) {
+            auto vector       = ::iovec{ .iov_base = const_cast<char *>(data.data()), .iov_len = data.size() };
+            auto header       = ::msghdr{};
+            header.msg_iov    = &vector;
+            header.msg_iovlen = 1;
+            if (!fds.empty()) {
+                header.msg_control    = control.data();
+                header.msg_controllen = control.size();
+                auto *part            = CMSG_FIRSTHDR(&header);
+                part->cmsg_level      = SOL_SOCKET;
+                part->cmsg_type       = SCM_RIGHTS;
+                part->cmsg_len        = CMSG_LEN(fds.size_bytes());
+                std::memcpy(CMSG_DATA(part), fds.data(), fds.size_bytes());
+            }
+            data.remove_prefix(static_cast<std::size_t>(sys::sendmsg(socket_fd, &header, SEND_FLAGS)));
+            fds = {};
+        }
+    }
+
+    /// Blocks for the next bytes, a whole message with SOCK_SEQPACKET, and the descriptors that came with them. Those
+    /// are close on exec and belong to the caller. A message that does not fit in `out` throws, its rest is lost.
+    /// Line reads take messages of up to BUFFER_SIZE bytes and throw on descriptors, which only `receive` takes.
+    auto receive(std::span<char> out) -> message
+    {
+        auto received = message{};
+        received.size = static_cast<std::size_t>(std::max(transfer(out, &received.fds), 0L));
+        return received;
+    }
+
+    /// Raw bytes, buffered ones first, 0 when nothing can be read right now.
+    auto read_some(std::span<char> out) -> std::size_t
+    {
+        if (out.empty()) {
+            return 0;
+        }
+        if (!partial_line.empty()) {
+            auto size = std::min(out.size(), partial_line.size());
+            std::copy_n(partial_line.begin(), size, out.begin());
+            partial_line.erase(0, size);
+            return size;
+        }
+        if (buffer.has_data()) {
+            return buffer.unload(out);
+        }
+        if (!can_be_read()) {
+            return 0;
+        }
+        return static_cast<std::size_t>(std::max(transfer(out, nullptr), 0L));
+    }
+
+    template<can_be_outstreamed... DATA_Ts>
+    auto operator()(DATA_Ts... data)
+    {
+        for (auto str : std::array{ to_string(data)... }) {
+            if (str.empty() || str.back() != '\n') {
+                str += '\n';
+            }
+            send(str);
+        }
+    }
+
+    expect_string operator()()
+    {
+        return take_line(
+            partial_line,
+            buffer,
+            [this] { return can_be_read(); },
+            [this] { buffer_load(); },
+            [this] { return socket_fd != -1 && !end_of_file; });
+    }
+
+    /// Blocks until the next line, nothing once the peer is gone and everything it sent was read.
+    auto next_line() -> std::optional<std::string>
+    {
+        using namespace std::literals;
+        while (true) {
+            if (auto line = (*this)(); line) {
+                return std::move(line).value();
+            }
+            if (socket_fd == -1 || end_of_file) {
+                return std::nullopt;
+            }
+            sys::poll(-1ms, sys::poll_arg{ .fd = socket_fd, .events = POLLIN });
+        }
+    }
+};
+
+using socket_channel = socket_channel_base<sys::PAGE_SIZE>;
+
+/// Both ends of a new socket pair of `type`: SOCK_STREAM, or SOCK_SEQPACKET to keep message boundaries.
+inline auto
+socket_pair(int type = SOCK_STREAM, std::source_location source = std::source_location::current())
+    -> std::pair<socket_channel, socket_channel>
+{
+    auto ends = sys::socketpair(type, source);
+    return { std::piecewise_construct, std::tuple{ ends[0] }, std::tuple{ ends[1] } };
+}
+
+}
+
+#endif
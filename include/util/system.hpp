@@ -5,26 +5,46 @@
 #include "debug.hpp"
 #include <fcntl.h>
 #include <poll.h>
+#include <sched.h>
+#include <signal.h>
 #include <spawn.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/epoll.h>
+#endif
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
+#include <exception>
 #include <filesystem>
 #include <iostream>
 #include <iterator>
+#include <mutex>
 #include <optional>
 #include <ranges>
 #include <source_location>
 #include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifndef __USE_GNU
@@ -34,6 +54,20 @@ extern "C"
 }
 #endif // !__USE_GNU
 
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define VB_HAS_SPAWN_ADDCHDIR 1
+#elif defined(__APPLE__)
+#define VB_HAS_SPAWN_ADDCHDIR 1
+#else
+#define VB_HAS_SPAWN_ADDCHDIR 0
+#endif
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define VB_HAS_SPAWN_ADDCLOSEFROM 1
+#else
+#define VB_HAS_SPAWN_ADDCLOSEFROM 0
+#endif
+
 namespace vb {
 
 namespace fs = std::filesystem;
@@ -102,7 +136,9 @@ throw_on_error(std::string_view name, INVOCABLE invocable, std::array<int, IGNOR
 }
 
 template<typename ARG_TYPE>
-concept is_arguments_type = std::ranges::sized_range<ARG_TYPE> && is_string<std::ranges::range_value_t<ARG_TYPE>>;
+concept is_arguments_type =
+    std::ranges::sized_range<ARG_TYPE> &&
+    (is_string<std::ranges::range_value_t<ARG_TYPE>> || std::same_as<std::ranges::range_value_t<ARG_TYPE>, fs::path>);
 
 struct Args
 {
@@ -173,16 +209,34 @@ exec(fs::path exe, is_arguments_type auto arguments, std::source_location source
     return exec(executable.c_str(), args_arr.data(), source);
 }
 
+/// Both ends are close on exec, a child only gets the ends dup2'ed onto its standard streams.
 inline auto
 pipe(std::source_location source = std::source_location::current()) -> std::array<int, 2>
 {
     std::array<int, 2> result{ -1, -1 };
+#ifdef __linux__
+    throw_on_error<call_type::ERRNO>("pipe2", [&result]() { return ::pipe2(result.data(), O_CLOEXEC); })(source);
+#else
     throw_on_error<call_type::ERRNO>("pipe", [&result]() { return ::pipe(result.data()); })(source);
+    for (auto fd : result) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
     return result;
 }
 
 using status_type = std::optional<int>;
 
+/// Exit code as a shell reports it, 128 + signal number for children killed by a signal.
+constexpr inline auto
+exit_code(int status) -> int
+{
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
 inline auto
 wait_pid(pid_t pid, int option = 0, std::source_location source = std::source_location::current()) -> status_type
 {
@@ -193,7 +247,79 @@ wait_pid(pid_t pid, int option = 0, std::source_location source = std::source_lo
     if (pid_r != pid) {
         return status_type{};
     }
-    return WEXITSTATUS(status);
+    return exit_code(status);
+}
+
+struct resource_usage
+{
+    using duration = std::chrono::microseconds;
+
+    duration user_time{};
+    duration system_time{};
+    long     max_resident_kb{};
+    long     minor_faults{};
+    long     major_faults{};
+    long     voluntary_switches{};
+    long     involuntary_switches{};
+
+    static auto from(const ::rusage& usage) -> resource_usage
+    {
+        auto to_duration = [](const ::timeval& time) {
+            return std::chrono::duration_cast<duration>(std::chrono::seconds{ time.tv_sec }) + duration{ time.tv_usec };
+        };
+        return resource_usage{ .user_time            = to_duration(usage.ru_utime),
+                               .system_time          = to_duration(usage.ru_stime),
+                               .max_resident_kb      = usage.ru_maxrss,
+                               .minor_faults         = usage.ru_minflt,
+                               .major_faults         = usage.ru_majflt,
+                               .voluntary_switches   = usage.ru_nvcsw,
+                               .involuntary_switches = usage.ru_nivcsw };
+    }
+};
+
+/// Like `wait_pid` but also fills `usage` with what the child consumed, once it is reaped.
+inline auto
+wait_pid(
+    pid_t                pid,
+    int                  option,
+    resource_usage&      usage,
+    std::source_location source = std::source_location::current()) -> status_type
+{
+    constexpr auto sys_wait4 =
+        throw_on_error<call_type::ERRNO, pid_t, int *, int, ::rusage *>("wait4", ::wait4, std::array{ EAGAIN });
+    int      status{ -1 };
+    ::rusage raw{};
+    int      pid_r = sys_wait4(pid, &status, option, &raw, source);
+    if (pid_r != pid) {
+        return status_type{};
+    }
+    usage = resource_usage::from(raw);
+    return exit_code(status);
+}
+
+struct reaped_child
+{
+    pid_t          pid{ -1 };
+    int            status{ -1 };
+    resource_usage usage{};
+};
+
+/// Reaps the next child of process `group` to exit, none once no child of it is left or, with WNOHANG, none exited.
+inline auto
+wait_group(pid_t group, int option = 0, std::source_location source = std::source_location::current())
+    -> std::optional<reaped_child>
+{
+    constexpr auto sys_wait4 = throw_on_error<call_type::ERRNO, pid_t, int *, int, ::rusage *>(
+        "wait4",
+        ::wait4,
+        std::array{ EAGAIN, ECHILD });
+    int      status{ -1 };
+    ::rusage raw{};
+    int      pid_r = sys_wait4(-group, &status, option, &raw, source);
+    if (pid_r <= 0) {
+        return {};
+    }
+    return reaped_child{ .pid = pid_r, .status = exit_code(status), .usage = resource_usage::from(raw) };
 }
 
 inline auto
@@ -232,6 +358,215 @@ constexpr inline auto write  = throw_on_error<call_type::ERRNO, int, const void
 constexpr inline auto close  = throw_on_error<call_type::ERRNO, int>("close", ::close);
 constexpr inline auto open   = throw_on_error<call_type::ERRNO, const char *, int>("open", ::open);
 constexpr inline auto fsync  = throw_on_error<call_type::ERRNO, int>("fsync", ::fsync);
+constexpr inline auto kill   = throw_on_error<call_type::ERRNO, pid_t, int>("kill", ::kill, std::array{ ESRCH });
+constexpr inline auto killpg = throw_on_error<call_type::ERRNO, pid_t, int>("killpg", ::killpg, std::array{ ESRCH });
+constexpr inline auto pread  = throw_on_error<call_type::ERRNO, int, void *, std::size_t, off_t>("pread", ::pread);
+
+// For non blocking descriptors, -1 with EAGAIN when the pipe is full and EPIPE when its reader is gone.
+constexpr inline auto write_some =
+    throw_on_error<call_type::ERRNO, int, const void *, std::size_t>("write", ::write, std::array{ EAGAIN, EPIPE });
+
+inline void
+write_all(int fd, std::string_view data, std::source_location source = std::source_location::current())
+{
+    while (!data.empty()) {
+        data.remove_prefix(static_cast<std::size_t>(write(fd, data.data(), data.size(), source)));
+    }
+}
+
+inline auto
+is_fifo(int fd) -> bool
+{
+    struct stat status{};
+    return ::fstat(fd, &status) == 0 && S_ISFIFO(status.st_mode);
+}
+
+constexpr inline auto fcntl  = throw_on_error<call_type::ERRNO, int, int, int>("fcntl", [](int fd, int cmd, int arg) {
+    return ::fcntl(fd, cmd, arg);
+});
+
+inline void
+set_nonblocking(int fd, std::source_location source = std::source_location::current())
+{
+    auto flags = fcntl(fd, F_GETFL, 0, source);
+    if ((flags & O_NONBLOCK) == 0) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK, source);
+    }
+}
+
+/// Connected unix domain sockets of `type`, both ends close on exec like those of `pipe`.
+inline auto
+socketpair(int type, std::source_location source = std::source_location::current()) -> std::array<int, 2>
+{
+    std::array<int, 2> result{ -1, -1 };
+#ifdef SOCK_CLOEXEC
+    throw_on_error<call_type::ERRNO>(
+        "socketpair",
+        [&result, type]() { return ::socketpair(AF_UNIX, type | SOCK_CLOEXEC, 0, result.data()); })(source);
+#else
+    throw_on_error<call_type::ERRNO>(
+        "socketpair",
+        [&result, type]() { return ::socketpair(AF_UNIX, type, 0, result.data()); })(source);
+    for (auto fd : result) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    return result;
+}
+
+constexpr inline auto sendmsg = throw_on_error<call_type::ERRNO, int, const ::msghdr *, int>("sendmsg", ::sendmsg);
+constexpr inline auto recvmsg =
+    throw_on_error<call_type::ERRNO, int, ::msghdr *, int>("recvmsg", ::recvmsg, std::array{ EAGAIN, EINTR });
+constexpr inline auto shutdown =
+    throw_on_error<call_type::ERRNO, int, int>("shutdown", ::shutdown, std::array{ ENOTCONN });
+
+constexpr inline auto ftruncate = throw_on_error<call_type::ERRNO, int, off_t>("ftruncate", ::ftruncate);
+constexpr inline auto munmap    = throw_on_error<call_type::ERRNO, void *, std::size_t>("munmap", ::munmap);
+
+/// Maps `size` bytes of `fd` for reading and writing, shared with every process that maps it too.
+inline auto
+map_shared(int fd, std::size_t size, std::source_location source = std::source_location::current()) -> void *
+{
+    void *address = nullptr;
+    throw_on_error<call_type::ERRNO>("mmap", [&address, fd, size]() {
+        address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return address == MAP_FAILED ? -1 : 0;
+    })(source);
+    return address;
+}
+
+#ifdef __linux__
+constexpr inline auto memfd_create =
+    throw_on_error<call_type::ERRNO, const char *, unsigned int>("memfd_create", ::memfd_create);
+
+// Copies pipe data without consuming it, EINVAL when `out` is not a pipe.
+constexpr inline auto tee = throw_on_error<call_type::ERRNO, int, int, std::size_t, unsigned int>(
+    "tee",
+    [](int in, int out, std::size_t size, unsigned int flags) { return ::tee(in, out, size, flags); },
+    std::array{ EINVAL, EAGAIN });
+
+constexpr inline auto epoll_create1 = throw_on_error<call_type::ERRNO, int>("epoll_create1", ::epoll_create1);
+constexpr inline auto epoll_wait =
+    throw_on_error<call_type::ERRNO, int, epoll_event *, int, int>("epoll_wait", ::epoll_wait, std::array{ EINTR });
+#endif
+
+#ifdef SYS_futex
+/// Sleeps as long as `word` holds `expected` but no longer than `timeout`, returns at once when it does not. The word
+/// may live in memory shared between processes. False only when the time ran out.
+inline auto
+futex_wait(
+    const std::atomic<std::uint32_t>& word,
+    std::uint32_t                     expected,
+    std::chrono::nanoseconds          timeout = std::chrono::nanoseconds::max(),
+    std::source_location              source  = std::source_location::current()) -> bool
+{
+    auto seconds = std::chrono::duration_cast<std::chrono::duration<time_t>>(timeout);
+    auto limit   = timespec{ .tv_sec = seconds.count(), .tv_nsec = (timeout - seconds).count() };
+    auto *bound  = timeout == std::chrono::nanoseconds::max() ? nullptr : &limit;
+    auto result  = throw_on_error<call_type::ERRNO>(
+        "futex_wait",
+        [&word, expected, bound]() {
+            return static_cast<int>(::syscall(SYS_futex, &word, FUTEX_WAIT, expected, bound, nullptr, 0));
+        },
+        std::array{ EAGAIN, EINTR, ETIMEDOUT })(source);
+    return result != -1 || errno != ETIMEDOUT;
+}
+
+/// Wakes up to `count` waiters of `word`, in this process or another one.
+inline void
+futex_wake(
+    const std::atomic<std::uint32_t>& word,
+    int                               count  = 1,
+    std::source_location              source = std::source_location::current())
+{
+    throw_on_error<call_type::ERRNO>("futex_wake", [&word, count]() {
+        return static_cast<int>(::syscall(SYS_futex, &word, FUTEX_WAKE, count, nullptr, nullptr, 0));
+    })(source);
+}
+#endif
+
+#ifdef SYS_pidfd_open
+/// File descriptor that becomes readable once `pid` exits, -1 when the kernel does not support it or there is no such
+/// process, errno tells which.
+inline auto
+pidfd_open(pid_t pid, std::source_location source = std::source_location::current()) -> int
+{
+    return throw_on_error<call_type::ERRNO>(
+        "pidfd_open",
+        [pid]() { return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0)); },
+        std::array{ ENOSYS, ESRCH })(source);
+}
+#endif
+
+/// Blocks `signum` in the calling thread, an occurrence raised meanwhile is discarded with the guard.
+class signal_block
+{
+    static constexpr auto thread_sigmask =
+        throw_on_error<call_type::SPAWN, int, const sigset_t *, sigset_t *>("pthread_sigmask", ::pthread_sigmask);
+
+    int      blocked;
+    sigset_t previous{};
+    bool     was_pending{ false };
+
+    static auto only(int signum) -> sigset_t
+    {
+        auto set = sigset_t{};
+        ::sigemptyset(&set);
+        ::sigaddset(&set, signum);
+        return set;
+    }
+
+    auto pending() const -> bool
+    {
+        auto set = sigset_t{};
+        ::sigpending(&set);
+        return ::sigismember(&set, blocked) == 1;
+    }
+
+public:
+    explicit signal_block(int signum, std::source_location source = std::source_location::current())
+        : blocked{ signum }
+    {
+        auto set = only(blocked);
+        thread_sigmask(SIG_BLOCK, &set, &previous, source);
+        was_pending = pending();
+    }
+
+    signal_block(const signal_block&)            = delete;
+    signal_block(signal_block&&)                 = delete;
+    signal_block& operator=(const signal_block&) = delete;
+    signal_block& operator=(signal_block&&)      = delete;
+
+    ~signal_block()
+    {
+        if (::sigismember(&previous, blocked) == 1) {
+            return;
+        }
+        if (!was_pending && pending()) {
+            auto set  = only(blocked);
+            auto zero = timespec{};
+            ::sigtimedwait(&set, nullptr, &zero);
+        }
+        ::pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+};
+
+/// The descriptors from `lowest` up that are open in this process right now.
+inline auto
+open_descriptors(int lowest) -> std::vector<int>
+{
+    auto descriptors = std::vector<int>{};
+    for (const auto& entry : fs::directory_iterator{ "/dev/fd" }) {
+        const auto name = entry.path().filename().string();
+        auto       fd   = -1;
+        if (std::from_chars(name.data(), name.data() + name.size(), fd).ec == std::errc{} && fd >= lowest) {
+            descriptors.push_back(fd);
+        }
+    }
+    // The descriptor of the directory listing itself is already gone.
+    std::erase_if(descriptors, [](int fd) { return ::fcntl(fd, F_GETFD) == -1; });
+    return descriptors;
+}
 
 struct at_dir
 {
@@ -268,12 +603,320 @@ enum class lookup
     NO_LOOKUP
 };
 
+/// Absolute paths of the executables found in $PATH, so that spawning them needs no search.
+/// A changed $PATH drops everything, an entry is checked against the modification time of the directories
+/// searched for it once it is older than the revalidation interval.
+class path_cache
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr auto REVALIDATE_AFTER = std::chrono::seconds{ 1 };
+
+private:
+    struct entry
+    {
+        fs::path                                             resolved;
+        std::vector<std::pair<fs::path, fs::file_time_type>> directories;
+        clock::time_point                                    checked;
+    };
+
+    std::mutex                             lock{};
+    std::string                            searched_path{};
+    std::unordered_map<std::string, entry> entries{};
+    clock::duration                        revalidate;
+
+    static auto modified(const fs::path& dir)
+    {
+        auto error = std::error_code{};
+        return fs::last_write_time(dir, error);
+    }
+
+    static auto search(const fs::path& name, std::string_view path) -> std::optional<entry>
+    {
+        auto found = entry{ .resolved = {}, .directories = {}, .checked = clock::now() };
+        for (auto part : path | std::views::split(':')) {
+            auto dir = fs::path{ std::string_view{ part } };
+            // The child may change directory before its exec, so relative entries are left to posix_spawnp.
+            if (dir.empty() || dir.is_relative()) {
+                return {};
+            }
+            found.directories.emplace_back(dir, modified(dir));
+            auto candidate = dir / name;
+            auto error     = std::error_code{};
+            if (fs::is_regular_file(candidate, error) && ::access(candidate.c_str(), X_OK) == 0) {
+                found.resolved = std::move(candidate);
+                return found;
+            }
+        }
+        return {};
+    }
+
+    static auto unchanged(const entry& cached)
+    {
+        return std::ranges::all_of(
+            cached.directories, [](const auto& dir) { return modified(dir.first) == dir.second; });
+    }
+
+public:
+    explicit path_cache(clock::duration revalidate_after = REVALIDATE_AFTER)
+        : revalidate{ revalidate_after }
+    {
+    }
+
+    /// Where posix_spawnp would find `name`, nothing for paths with a directory or names it has to look up itself.
+    auto resolve(const fs::path& name) -> std::optional<fs::path>
+    {
+        if (name.empty() || name.has_parent_path()) {
+            return {};
+        }
+        const auto *path_value = std::getenv("PATH");
+        const auto  path       = std::string_view{ path_value == nullptr ? "" : path_value };
+
+        auto guard = std::lock_guard{ lock };
+        if (path != searched_path) {
+            entries.clear();
+            searched_path = path;
+        }
+        if (auto cached = entries.find(name.native()); cached != std::end(entries)) {
+            auto& found = cached->second;
+            if (clock::now() - found.checked < revalidate || unchanged(found)) {
+                found.checked = clock::now();
+                return found.resolved;
+            }
+            entries.erase(cached);
+        }
+        auto found = search(name, path);
+        if (!found.has_value()) {
+            return {};
+        }
+        return entries.insert_or_assign(name.native(), std::move(found).value()).first->second.resolved;
+    }
+
+    void clear()
+    {
+        auto guard = std::lock_guard{ lock };
+        entries.clear();
+    }
+
+    /// The cache used by prepared commands.
+    static auto global() -> path_cache&
+    {
+        static auto instance = path_cache{};
+        return instance;
+    }
+};
+
+// glibc (≥ 2.24) and musl already spawn with CLONE_VM | CLONE_VFORK, VFORK only changes anything on libcs that
+// still default to a fork based posix_spawn.
+enum class spawn_mode
+{
+    DEFAULT,
+    VFORK
+};
+
+class spawn_attributes
+{
+    posix_spawnattr_t attributes{};
+
+    constexpr static auto spawnattr_init{
+        throw_on_error<call_type::SPAWN, posix_spawnattr_t *>("posix_spawnattr_init", ::posix_spawnattr_init)
+    };
+
+    constexpr static auto spawnattr_destroy{
+        throw_on_error<call_type::SPAWN, posix_spawnattr_t *>("posix_spawnattr_destroy", ::posix_spawnattr_destroy)
+    };
+
+    constexpr static auto spawnattr_getflags{ throw_on_error<call_type::SPAWN, const posix_spawnattr_t *, short *>(
+        "posix_spawnattr_getflags",
+        ::posix_spawnattr_getflags) };
+
+    constexpr static auto spawnattr_setflags{ throw_on_error<call_type::SPAWN, posix_spawnattr_t *, short>(
+        "posix_spawnattr_setflags",
+        ::posix_spawnattr_setflags) };
+
+    constexpr static auto spawnattr_setpgroup{ throw_on_error<call_type::SPAWN, posix_spawnattr_t *, pid_t>(
+        "posix_spawnattr_setpgroup",
+        ::posix_spawnattr_setpgroup) };
+
+    constexpr static auto spawnattr_getpgroup{ throw_on_error<call_type::SPAWN, const posix_spawnattr_t *, pid_t *>(
+        "posix_spawnattr_getpgroup",
+        ::posix_spawnattr_getpgroup) };
+
+    constexpr static auto spawnattr_getschedpolicy{ throw_on_error<call_type::SPAWN, const posix_spawnattr_t *, int *>(
+        "posix_spawnattr_getschedpolicy",
+        ::posix_spawnattr_getschedpolicy) };
+
+    constexpr static auto spawnattr_getschedparam{
+        throw_on_error<call_type::SPAWN, const posix_spawnattr_t *, sched_param *>(
+            "posix_spawnattr_getschedparam",
+            ::posix_spawnattr_getschedparam)
+    };
+
+    constexpr static auto spawnattr_setschedpolicy{ throw_on_error<call_type::SPAWN, posix_spawnattr_t *, int>(
+        "posix_spawnattr_setschedpolicy",
+        ::posix_spawnattr_setschedpolicy) };
+
+    constexpr static auto spawnattr_setschedparam{
+        throw_on_error<call_type::SPAWN, posix_spawnattr_t *, const sched_param *>(
+            "posix_spawnattr_setschedparam",
+            ::posix_spawnattr_setschedparam)
+    };
+
+#ifdef POSIX_SPAWN_USEVFORK
+    static constexpr short VFORK_FLAG = POSIX_SPAWN_USEVFORK;
+#else
+    static constexpr short VFORK_FLAG = 0;
+#endif
+
+#ifdef __linux__
+    std::optional<cpu_set_t> cpus{};
+    std::optional<int>       linux_policy{};
+#endif
+    std::optional<int> niceness{};
+
+public:
+    spawn_attributes(std::source_location source = std::source_location::current())
+    {
+        spawnattr_init(&attributes, source);
+    }
+
+    spawn_attributes(const spawn_attributes&)            = delete;
+    spawn_attributes(spawn_attributes&&)                 = delete;
+    spawn_attributes& operator=(const spawn_attributes&) = delete;
+    spawn_attributes& operator=(spawn_attributes&&)      = delete;
+
+    ~spawn_attributes() { spawnattr_destroy(&attributes); }
+
+    void add_flags(short flags, std::source_location source = std::source_location::current())
+    {
+        short current{ 0 };
+        spawnattr_getflags(&attributes, &current, source);
+        spawnattr_setflags(&attributes, static_cast<short>(current | flags), source);
+    }
+
+    void mode(spawn_mode spawning, std::source_location source = std::source_location::current())
+    {
+        if (spawning == spawn_mode::VFORK && VFORK_FLAG != 0) {
+            add_flags(VFORK_FLAG, source);
+        }
+    }
+
+    /// Process group the child joins before it runs, 0 makes it the leader of a new group named after its pid.
+    void process_group(pid_t group, std::source_location source = std::source_location::current())
+    {
+        spawnattr_setpgroup(&attributes, group, source);
+        add_flags(POSIX_SPAWN_SETPGROUP, source);
+    }
+
+    /// Policy and static priority the child starts with, SCHED_OTHER, SCHED_BATCH and SCHED_IDLE need priority 0.
+    void scheduling(int policy, int priority = 0, std::source_location source = std::source_location::current())
+    {
+#ifdef __linux__
+        if (policy == SCHED_BATCH || policy == SCHED_IDLE) {
+            // posix_spawnattr_setschedpolicy only takes the POSIX policies, the spawning thread passes these on.
+            linux_policy = policy;
+            return;
+        }
+#endif
+        auto parameters = sched_param{ .sched_priority = priority };
+        spawnattr_setschedpolicy(&attributes, policy, source);
+        spawnattr_setschedparam(&attributes, &parameters, source);
+        add_flags(static_cast<short>(POSIX_SPAWN_SETSCHEDULER | POSIX_SPAWN_SETSCHEDPARAM), source);
+    }
+
+#ifdef __linux__
+    /// The child only runs on these CPUs from its first instruction on. Like a nice value or a Linux only policy it is
+    /// passed on by a helper thread that makes the spawn, the thread calling it is never moved.
+    void affinity(std::span<const int> allowed)
+    {
+        auto set = cpu_set_t{};
+        CPU_ZERO(&set);
+        for (auto cpu : allowed) {
+            CPU_SET(static_cast<std::size_t>(cpu), &set);
+        }
+        cpus = set;
+    }
+
+    auto affinity() const noexcept -> const std::optional<cpu_set_t>& { return cpus; }
+
+    auto thread_policy() const noexcept { return linux_policy; }
+#endif
+
+    /// Nice value of the child, posix_spawn has no attribute for it so the spawn runs on a thread with that value. A
+    /// helper thread is only started when a nice value, SCHED_BATCH or SCHED_IDLE, or an affinity is set.
+    void nice(int value) { niceness = value; }
+
+    auto nice() const noexcept { return niceness; }
+
+    auto get() const noexcept -> const posix_spawnattr_t * { return &attributes; }
+
+    /// Takes every setting of `defaults` that was not made on these attributes themselves.
+    void inherit(const spawn_attributes& defaults, std::source_location source = std::source_location::current())
+    {
+        short own{ 0 };
+        short other{ 0 };
+        spawnattr_getflags(&attributes, &own, source);
+        spawnattr_getflags(&defaults.attributes, &other, source);
+        if ((other & VFORK_FLAG) != 0) {
+            add_flags(VFORK_FLAG, source);
+        }
+        if ((other & POSIX_SPAWN_SETPGROUP) != 0 && (own & POSIX_SPAWN_SETPGROUP) == 0) {
+            pid_t group{ 0 };
+            spawnattr_getpgroup(&defaults.attributes, &group, source);
+            process_group(group, source);
+        }
+        auto scheduled = [](short flags) { return (flags & POSIX_SPAWN_SETSCHEDULER) != 0; };
+#ifdef __linux__
+        if (!scheduled(own) && !linux_policy.has_value() && defaults.linux_policy.has_value()) {
+            linux_policy = defaults.linux_policy;
+        }
+        if (!cpus.has_value()) {
+            cpus = defaults.cpus;
+        }
+        own = linux_policy.has_value() ? static_cast<short>(own | POSIX_SPAWN_SETSCHEDULER) : own;
+#endif
+        if (scheduled(other) && !scheduled(own)) {
+            auto policy     = 0;
+            auto parameters = sched_param{};
+            spawnattr_getschedpolicy(&defaults.attributes, &policy, source);
+            spawnattr_getschedparam(&defaults.attributes, &parameters, source);
+            spawnattr_setschedpolicy(&attributes, policy, source);
+            spawnattr_setschedparam(&attributes, &parameters, source);
+            add_flags(static_cast<short>(POSIX_SPAWN_SETSCHEDULER | POSIX_SPAWN_SETSCHEDPARAM), source);
+        }
+        if (!niceness.has_value()) {
+            niceness = defaults.niceness;
+        }
+    }
+};
+
+#ifdef __linux__
+constexpr inline auto set_affinity = throw_on_error<call_type::ERRNO, pid_t, std::size_t, const cpu_set_t *>(
+    "sched_setaffinity",
+    ::sched_setaffinity);
+#endif
+
+constexpr inline auto set_scheduler = throw_on_error<call_type::ERRNO, pid_t, int, const sched_param *>(
+    "sched_setscheduler",
+    ::sched_setscheduler);
+
+constexpr inline auto set_nice = throw_on_error<call_type::ERRNO, pid_t, int>(
+    "setpriority",
+    [](pid_t pid, int value) { return ::setpriority(PRIO_PROCESS, static_cast<id_t>(pid), value); },
+    std::array{ ESRCH });
+
 class spawn
 {
     posix_spawn_file_actions_t file_actions{};
-    posix_spawnattr_t          attributes{};
+    spawn_attributes           attributes{};
     pid_t                      pid{ -1 };
-    fs::path                   work_directory{ "." };
+#if !VB_HAS_SPAWN_ADDCHDIR
+    std::optional<fs::path>    work_directory{};
+#endif
+#if !VB_HAS_SPAWN_ADDCLOSEFROM
+    std::vector<int>           closed_fds{};
+#endif
 
     template<lookup LOOKUP>
     static constexpr auto posix_spawn{ throw_on_error<
@@ -316,34 +959,95 @@ class spawn
             ::posix_spawn_file_actions_adddup2)
     };
 
-    constexpr static auto spawnattr_init{
-        throw_on_error<call_type::SPAWN, posix_spawnattr_t *>("posix_spawnattr_init", ::posix_spawnattr_init)
+    constexpr static auto spawn_file_actions_addopen{
+        throw_on_error<call_type::SPAWN, posix_spawn_file_actions_t *, int, const char *, int, mode_t>(
+            "posix_spawn_file_actions_addopen",
+            ::posix_spawn_file_actions_addopen)
     };
 
-    constexpr static auto spawnattr_destroy{
-        throw_on_error<call_type::SPAWN, posix_spawnattr_t *>("posix_spawnattr_destroy", ::posix_spawnattr_destroy)
+#if VB_HAS_SPAWN_ADDCHDIR
+    constexpr static auto spawn_file_actions_addchdir{
+        throw_on_error<call_type::SPAWN, posix_spawn_file_actions_t *, const char *>(
+            "posix_spawn_file_actions_addchdir_np",
+            ::posix_spawn_file_actions_addchdir_np)
+    };
+#endif
+
+#if VB_HAS_SPAWN_ADDCLOSEFROM
+    constexpr static auto spawn_file_actions_addclosefrom{
+        throw_on_error<call_type::SPAWN, posix_spawn_file_actions_t *, int>(
+            "posix_spawn_file_actions_addclosefrom_np",
+            ::posix_spawn_file_actions_addclosefrom_np)
     };
+#endif
 
     auto do_spawn(
-        lookup               path_lookup,
-        char                *cmd,
-        char *const         *args,
-        char *const         *env,
-        std::source_location source = std::source_location::current())
+        lookup                  path_lookup,
+        const char             *cmd,
+        char *const            *args,
+        char *const            *env,
+        const spawn_attributes& spawning,
+        std::source_location    source = std::source_location::current())
     {
-        at_dir change{ work_directory };
+#if !VB_HAS_SPAWN_ADDCHDIR
+        // Without a child side chdir the whole process has to move, this is not thread safe.
+        auto change = work_directory.has_value() ? std::optional<at_dir>{ std::in_place, work_directory.value() }
+                                                 : std::optional<at_dir>{};
+#endif
 
         if (env == nullptr) {
             env = ::environ;
         }
-        return function(path_lookup)(&pid, cmd, &file_actions, &attributes, args, env, source);
+        auto launch = [&] {
+            return function(path_lookup)(&pid, cmd, &file_actions, spawning.get(), args, env, source);
+        };
+        auto value = spawning.nice();
+#ifdef __linux__
+        auto policy = spawning.thread_policy();
+        auto cpus   = spawning.affinity();
+        if (!value.has_value() && !policy.has_value() && !cpus.has_value()) {
+            return launch();
+        }
+        // Nice values, policies and affinities belong to threads on Linux, a thread of its own passes them on to the
+        // child and the calling thread keeps its own.
+        auto result  = 0;
+        auto failure = std::exception_ptr{};
+        auto helper  = std::jthread{ [&] {
+            try {
+                auto self = static_cast<pid_t>(::syscall(SYS_gettid));
+                if (cpus.has_value()) {
+                    set_affinity(self, sizeof(cpu_set_t), &cpus.value(), source);
+                }
+                if (policy.has_value()) {
+                    auto parameters = sched_param{ .sched_priority = 0 };
+                    set_scheduler(self, policy.value(), &parameters, source);
+                }
+                if (value.has_value()) {
+                    set_nice(self, value.value(), source);
+                }
+                result = launch();
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        } };
+        helper.join();
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+#else
+        auto result = launch();
+        if (value.has_value()) {
+            set_nice(pid, value.value(), source);
+        }
+#endif
+        return result;
     }
 
 public:
     spawn(std::source_location source = std::source_location::current())
+        : attributes{ source }
     {
         spawn_file_actions_init(&file_actions, source);
-        spawnattr_init(&attributes, source);
     }
 
     spawn(const spawn&)            = delete;
@@ -351,22 +1055,90 @@ public:
     spawn& operator=(const spawn&) = delete;
     spawn& operator=(spawn&&)      = delete;
 
-    ~spawn()
+    ~spawn() { spawn_file_actions_destroy(&file_actions); }
+
+    void cwd(const fs::path& dir, std::source_location source = std::source_location::current())
     {
-        spawn_file_actions_destroy(&file_actions);
-        spawnattr_destroy(&attributes);
+#if VB_HAS_SPAWN_ADDCHDIR
+        spawn_file_actions_addchdir(&file_actions, dir.c_str(), source);
+#else
+        static_cast<void>(source);
+        work_directory = dir;
+#endif
     }
 
-    void cwd(fs::path dir) { work_directory = dir; }
+    void add_flags(short flags, std::source_location source = std::source_location::current())
+    {
+        attributes.add_flags(flags, source);
+    }
+
+    void mode(spawn_mode spawning, std::source_location source = std::source_location::current())
+    {
+        attributes.mode(spawning, source);
+    }
+
+    void process_group(pid_t group, std::source_location source = std::source_location::current())
+    {
+        attributes.process_group(group, source);
+    }
+
+    void scheduling(int policy, int priority = 0, std::source_location source = std::source_location::current())
+    {
+        attributes.scheduling(policy, priority, source);
+    }
+
+#ifdef __linux__
+    void affinity(std::span<const int> allowed) { attributes.affinity(allowed); }
+#endif
+
+    void nice(int value) { attributes.nice(value); }
+
+    auto get_attributes() const noexcept -> const spawn_attributes& { return attributes; }
+
+    /// Settings of `defaults` that were not made on this spawn are used as well.
+    void inherit(const spawn_attributes& defaults, std::source_location source = std::source_location::current())
+    {
+        attributes.inherit(defaults, source);
+    }
 
     void setup_dup2(int fromFd, int toFd, std::source_location source = std::source_location::current())
     {
         spawn_file_actions_adddup2(&file_actions, fromFd, toFd, source);
     }
 
+    void add_open(
+        int                  fd,
+        const fs::path&      path,
+        int                  flags,
+        mode_t               mode   = 0666,
+        std::source_location source = std::source_location::current())
+    {
+        spawn_file_actions_addopen(&file_actions, fd, path.c_str(), flags, mode, source);
+    }
+
     void add_close(int fd, std::source_location source = std::source_location::current())
     {
         spawn_file_actions_addclose(&file_actions, fd, source);
+#if !VB_HAS_SPAWN_ADDCLOSEFROM
+        closed_fds.push_back(fd);
+#endif
+    }
+
+    /// Closes every descriptor from `lowest` up in the child, after the actions added so far. Without
+    /// posix_spawn_file_actions_addclosefrom_np each descriptor open at this point gets a close action of its own,
+    /// the ones opened later by other threads are still inherited unless they are close on exec.
+    void close_from(int lowest, std::source_location source = std::source_location::current())
+    {
+#if VB_HAS_SPAWN_ADDCLOSEFROM
+        spawn_file_actions_addclosefrom(&file_actions, lowest, source);
+#else
+        for (auto fd : open_descriptors(lowest)) {
+            // Closing one twice fails the whole spawn on some systems.
+            if (std::ranges::find(closed_fds, fd) == std::end(closed_fds)) {
+                add_close(fd, source);
+            }
+        }
+#endif
     }
 
     void move_fd(int fromFd, int toFd, std::source_location source = std::source_location::current())
@@ -375,13 +1147,35 @@ public:
         add_close(fromFd, source);
     }
 
+    int operator()(
+        lookup                  path_lookup,
+        char *const            *args,
+        char *const            *env,
+        const spawn_attributes& spawning,
+        std::source_location    source = std::source_location::current())
+    {
+        return do_spawn(path_lookup, args[0], args, env, spawning, source);
+    }
+
+    /// Spawns the executable at `path`, `args[0]` is only what the child sees as its name.
+    int operator()(
+        lookup                  path_lookup,
+        const char             *path,
+        char *const            *args,
+        char *const            *env,
+        const spawn_attributes& spawning,
+        std::source_location    source = std::source_location::current())
+    {
+        return do_spawn(path_lookup, path, args, env, spawning, source);
+    }
+
     int operator()(
         lookup                 path_lookup,
         is_arguments_type auto args,
         std::source_location   source = std::source_location::current())
     {
         auto c_args = Args(args);
-        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), nullptr, source);
+        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), nullptr, attributes, source);
     }
 
     int operator()(
@@ -392,7 +1186,7 @@ public:
     {
         auto c_args = Args(args);
         auto c_env  = Args(env);
-        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), c_env.data(), source);
+        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), c_env.data(), attributes, source);
     }
 
     int operator()(
@@ -402,7 +1196,7 @@ public:
         std::source_location   source = std::source_location::current())
     {
         auto c_args = Args(exec, args);
-        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), nullptr, source);
+        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), nullptr, attributes, source);
     }
 
     int operator()(
@@ -415,7 +1209,7 @@ public:
         auto c_args     = Args(exec, args);
         auto c_env      = Args(env);
         auto executable = exec.native();
-        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), c_env.data(), source);
+        return do_spawn(path_lookup, c_args.arg0(), c_args.data(), c_env.data(), attributes, source);
     }
 
     auto get_pid() const { return pid; }
@@ -0,0 +1,162 @@
+// task.hpp                                                                        -*-C++-*-
+#ifndef INCLUDED_TASK_HPP
+#define INCLUDED_TASK_HPP
+
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace vb {
+
+template<typename VALUE_TYPE = void>
+struct task;
+
+namespace detail {
+
+struct task_promise_base
+{
+    std::exception_ptr      exception{};
+    std::coroutine_handle<> continuation{ std::noop_coroutine() };
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template<typename PROMISE_TYPE>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<PROMISE_TYPE> handle) noexcept
+        {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter       final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    void rethrow() const
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+template<typename VALUE_TYPE>
+struct task_promise : task_promise_base
+{
+    std::optional<VALUE_TYPE> value{};
+
+    task<VALUE_TYPE> get_return_object() noexcept;
+
+    template<std::convertible_to<VALUE_TYPE> RETURN_TYPE>
+    void return_value(RETURN_TYPE&& returned)
+    {
+        value.emplace(std::forward<RETURN_TYPE>(returned));
+    }
+
+    VALUE_TYPE result()
+    {
+        rethrow();
+        return std::move(value).value();
+    }
+};
+
+template<>
+struct task_promise<void> : task_promise_base
+{
+    task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result() const { rethrow(); }
+};
+
+}
+
+/// Lazy coroutine, it starts when awaited and resumes the awaiting coroutine when it finishes.
+template<typename VALUE_TYPE>
+struct task
+{
+    using value_type   = VALUE_TYPE;
+    using promise_type = detail::task_promise<VALUE_TYPE>;
+    using handle_type  = std::coroutine_handle<promise_type>;
+
+    handle_type handle;
+
+    explicit task(handle_type handle_) noexcept
+        : handle{ handle_ }
+    {
+    }
+
+    task(const task&) = delete;
+    task(task&& other) noexcept
+        : handle{ std::exchange(other.handle, nullptr) }
+    {
+    }
+
+    task& operator=(const task&) = delete;
+    task& operator=(task&& other) noexcept
+    {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+
+    ~task()
+    {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool done() const noexcept { return !handle || handle.done(); }
+
+    /// Starts a task that nobody awaits, it runs until its first suspension point.
+    void start() { handle.resume(); }
+
+    VALUE_TYPE result() { return handle.promise().result(); }
+
+    auto operator co_await() noexcept
+    {
+        struct awaiter
+        {
+            handle_type awaited;
+
+            bool await_ready() noexcept { return !awaited || awaited.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                awaited.promise().continuation = awaiting;
+                return awaited;
+            }
+
+            VALUE_TYPE await_resume() { return awaited.promise().result(); }
+        };
+        return awaiter{ handle };
+    }
+};
+
+namespace detail {
+
+template<typename VALUE_TYPE>
+task<VALUE_TYPE>
+task_promise<VALUE_TYPE>::get_return_object() noexcept
+{
+    return task<VALUE_TYPE>{ std::coroutine_handle<task_promise>::from_promise(*this) };
+}
+
+inline task<void>
+task_promise<void>::get_return_object() noexcept
+{
+    return task<void>{ std::coroutine_handle<task_promise>::from_promise(*this) };
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+// batch.cpp                                                                        -*-C++-*-
+#include "util/batch.hpp"
+#include "util/command.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+TEST_CASE("Packing arguments into batches", "[batch]")
+{
+    static constexpr auto cost = sizeof(char *) + 2;
+
+    auto inputs = std::vector{ "a"s, "b"s, "c"s, "d"s, "e"s };
+    CHECK(vb::argument_batches(inputs, 100 * cost).size() == 1);
+    CHECK(
+        vb::argument_batches(inputs, 2 * cost) ==
+        std::vector<std::vector<std::string>>{ { "a", "b" }, { "c", "d" }, { "e" } });
+    CHECK(
+        vb::argument_batches(inputs, 100 * cost, 3) ==
+        std::vector<std::vector<std::string>>{ { "a", "b", "c" }, { "d", "e" } });
+
+    auto oversized = std::vector{ "a"s, std::string(100, 'x'), "b"s };
+    CHECK(vb::argument_batches(oversized, 2 * cost).size() == 3);
+    CHECK(vb::argument_batches(std::vector<std::string>{}, cost).empty());
+}
+
+TEST_CASE("Argument space of a command", "[batch]")
+{
+    auto command = vb::prepared_command{ vb::fs::path{ "/bin/echo" } };
+    auto space   = vb::argument_space(command);
+    CHECK(space > 0);
+    CHECK(space < static_cast<std::size_t>(::sysconf(_SC_ARG_MAX)));
+}
+
+TEST_CASE("Running batches concurrently", "[batch][execute]")
+{
+    static constexpr auto count = 1000;
+
+    auto script   = std::array{ "-c"s, "printf '%s\\n' \"$@\""s, "sh"s };
+    auto command  = vb::prepared_command{ vb::fs::path{ "/bin/sh" }, script };
+    auto inputs   = std::vector<std::string>{};
+    auto expected = std::string{};
+    for (auto index = 0; index < count; ++index) {
+        inputs.push_back(std::to_string(index));
+        expected += inputs.back() + "\n";
+    }
+
+    SECTION("ordered")
+    {
+        auto results = vb::run_batches(command, inputs, { .concurrency = 4, .max_arguments = 64 });
+        REQUIRE(results.size() == (count + 63) / 64);
+        auto output = std::string{};
+        for (const auto& result : results) {
+            CHECK(result.status == 0);
+            CHECK(result.err.empty());
+            output += result.out;
+        }
+        CHECK(output == expected);
+    }
+    SECTION("in completion order")
+    {
+        auto results = vb::run_batches(command, inputs, { .concurrency = 4, .max_arguments = 64, .ordered = false });
+        REQUIRE(results.size() == (count + 63) / 64);
+        std::ranges::sort(results, {}, [](const auto& result) { return std::stoi(result.arguments.front()); });
+        auto output = std::string{};
+        for (const auto& result : results) {
+            output += result.out;
+        }
+        CHECK(output == expected);
+    }
+    SECTION("limited by size")
+    {
+        auto results = vb::run_batches(command, inputs, { .max_bytes = 1024 });
+        CHECK(results.size() > 1);
+        auto arguments = std::size_t{ 0 };
+        for (const auto& result : results) {
+            arguments += result.arguments.size();
+        }
+        CHECK(arguments == count);
+    }
+}
+
+TEST_CASE("Batches do not read the parent stdin", "[batch][execute]")
+{
+    auto command = vb::prepared_command{ vb::fs::path{ "/usr/bin/readlink" } };
+    auto inputs  = std::vector{ "/proc/self/fd/0"s };
+    auto results = vb::run_batches(command, inputs);
+    REQUIRE(results.size() == 1);
+    CHECK(results.front().status == 0);
+    CHECK(results.front().out == "/dev/null\n");
+}
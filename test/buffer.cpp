@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <array>
 #include <iterator>
+#include <string>
+#include <vector>
 
 TEST_CASE("Buffer", "[buffer][generator]")
 {
@@ -32,3 +34,25 @@ TEST_CASE("Buffer", "[buffer][generator]")
     REQUIRE(hello.load(reader(std::string(BIG, '-'))) == vb::sys::PAGE_SIZE);
     REQUIRE(hello.unload_line() == std::string(vb::sys::PAGE_SIZE, '-'));
 }
+
+TEST_CASE("Ring buffer keeps the tail", "[buffer][ring]")
+{
+    auto ring = vb::ring_buffer_type<16>();
+    REQUIRE(ring.last_lines(3).empty());
+
+    ring.append("one\ntwo\n");
+    REQUIRE(ring.str() == "one\ntwo\n");
+    REQUIRE(ring.last_lines(5) == std::vector<std::string>{ "one\n", "two\n" });
+
+    ring.append("three\nfour\n");
+    REQUIRE(ring.size() == 16);
+    REQUIRE(ring.discarded() == 3);
+    REQUIRE(ring.str() == "\ntwo\nthree\nfour\n");
+    REQUIRE(ring.last_lines(5) == std::vector<std::string>{ "two\n", "three\n", "four\n" });
+    REQUIRE(ring.last_lines(1) == std::vector<std::string>{ "four\n" });
+
+    ring.append(std::string(40, '-') + "\nlast");
+    REQUIRE(ring.discarded() == 3 + 16 + 45 - 16);
+    REQUIRE(ring.str() == "-----------\nlast");
+    REQUIRE(ring.last_lines(5) == std::vector<std::string>{ "last" });
+}
@@ -0,0 +1,89 @@
+// coprocess.cpp                                                                        -*-C++-*-
+#include "util/coprocess.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+TEST_CASE("Coprocess answers requests", "[coprocess][execute][pipe]")
+{
+    auto worker = vb::coprocess{ vb::fs::path{ "/bin/cat" } };
+    auto pid    = worker.pid();
+    for (auto index = 0; index < 100; ++index) {
+        CHECK(worker.request(std::to_string(index)) == std::to_string(index) + "\n");
+    }
+    CHECK(worker.pid() == pid);
+    CHECK(worker.restarts() == 0);
+}
+
+TEST_CASE("Coprocess with several response lines", "[coprocess][execute][pipe]")
+{
+    auto script = std::array{ "-c"s, "while read l; do echo \"$l\"; echo end; done"s };
+    auto worker = vb::coprocess{ vb::fs::path{ "/bin/sh" }, script };
+    CHECK(worker.request("first", 2) == std::vector{ "first\n"s, "end\n"s });
+    CHECK(worker.request("second", 2) == std::vector{ "second\n"s, "end\n"s });
+}
+
+TEST_CASE("Coprocess is spawned again after a crash", "[coprocess][execute][pipe]")
+{
+    SECTION("worker exiting after each answer")
+    {
+        auto worker =
+            vb::coprocess{ vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "read l; echo \"$l\"; exit 1"s } };
+        CHECK(worker.request("one") == "one\n");
+        CHECK(worker.request("two") == "two\n");
+        CHECK(worker.restarts() == 1);
+    }
+    SECTION("worker that never answers")
+    {
+        auto worker = vb::coprocess{ vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "read l; exit 1"s } };
+        CHECK_THROWS_AS(worker.request("lost"), std::runtime_error);
+        CHECK(worker.restarts() == 1);
+    }
+}
+
+TEST_CASE("Coprocess pool shared between threads", "[coprocess][execute][pipe][thread]")
+{
+    static constexpr auto count = 8;
+    auto                  pool  = vb::coprocess_pool{ 3, vb::fs::path{ "/bin/cat" }, std::array<std::string, 0>{} };
+    REQUIRE(pool.size() == 3);
+
+    auto results = std::vector<std::string>(count);
+    {
+        auto threads = std::vector<std::jthread>{};
+        for (auto index = 0; index < count; ++index) {
+            threads.emplace_back([&pool, &results, index] {
+                for (auto round = 0; round < 20; ++round) {
+                    results.at(static_cast<std::size_t>(index)) = pool.request(std::to_string(index));
+                }
+            });
+        }
+    }
+    for (auto index = 0; index < count; ++index) {
+        CHECK(results.at(static_cast<std::size_t>(index)) == std::to_string(index) + "\n");
+    }
+}
+
+// Run with: basic_utils_test "[benchmark]"
+TEST_CASE("Coprocess round trip against a spawn per request", "[.][benchmark][coprocess]")
+{
+    auto worker = vb::coprocess{ vb::fs::path{ "/bin/cat" } };
+
+    BENCHMARK("coprocess round trip")
+    {
+        return worker.request("ping");
+    };
+
+    BENCHMARK("spawn per request")
+    {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/bin/echo" }, std::array{ "ping"s });
+        return handler.wait();
+    };
+}
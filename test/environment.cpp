@@ -65,6 +65,40 @@ TEST_CASE("enviroment_defintions", "[environment][definition]")
     REQUIRE_THAT(env, Catch::Matchers::VectorContains("USER=me"s));
 }
 
+TEST_CASE("environment_block", "[environment][definition][block]")
+{
+    auto as_vector = [](char *const *envp) {
+        auto result = std::vector<std::string>{};
+        for (; *envp != nullptr; ++envp) {
+            result.emplace_back(*envp);
+        }
+        return result;
+    };
+
+    env::environment env_test{};
+    REQUIRE(*env_test.envp() == nullptr);
+
+    env_test.set("A") = "1";
+    REQUIRE(as_vector(env_test.envp()) == std::vector{ "A=1"s });
+
+    for (auto index = 0; index < 300; ++index) {
+        env_test.set("VAR_" + std::to_string(index)) = index;
+    }
+    auto envp = as_vector(env_test.envp());
+    REQUIRE(envp.size() == 301);
+    REQUIRE(envp == env_test.getEnv());
+
+    env_test.set("A") = "2";
+    REQUIRE(as_vector(env_test.envp()) == env_test.getEnv());
+    REQUIRE_THAT(as_vector(env_test.envp()), Catch::Matchers::VectorContains("A=2"s));
+
+    auto copy = env_test;
+    copy.set("B") = "3";
+    REQUIRE(as_vector(env_test.envp()).size() == 301);
+    REQUIRE(as_vector(copy.envp()).size() == 302);
+    REQUIRE(as_vector(copy.envp()) == copy.getEnv());
+}
+
 static_assert(vb::formatable<vb::env::environment>);
 
 TEST_CASE("Environment_formatter", "[environment][formatter]") {
@@ -4,8 +4,15 @@
 #include "util/system.hpp"
 #include <catch2/catch_all.hpp>
 
+#include <cstddef>
+#include <ranges>
+#include <set>
 #include <source_location>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 static constexpr auto test_dir = []() {
     auto file = std::string_view{ std::source_location::current().file_name() };
@@ -81,3 +88,511 @@ TEST_CASE("Execution of external command with environment", "[execute][pipe][buf
     }
     REQUIRE(result == "a\n");
 }
+
+TEST_CASE("Execution without an environment", "[execute][pipe][environment]")
+{
+    auto handler = vb::execution(vb::io_set::OUT);
+    handler.execute(vb::fs::path{ "/usr/bin/env" });
+    auto lines = std::vector<std::string>{};
+    for (auto line : handler.lines<vb::std_io::OUT>()) {
+        lines.push_back(line);
+    }
+    REQUIRE(handler.wait() == 0);
+    CHECK(lines.empty());
+
+    auto command  = vb::prepared_command{ vb::fs::path{ "/usr/bin/env" } };
+    auto prepared = vb::execution(vb::io_set::OUT);
+    prepared.execute(command);
+    for (auto line : prepared.lines<vb::std_io::OUT>()) {
+        lines.push_back(line);
+    }
+    REQUIRE(prepared.wait() == 0);
+    CHECK(lines.empty());
+}
+
+TEST_CASE("Execution on a working directory", "[execute][pipe][cwd]")
+{
+    auto before  = vb::fs::current_path();
+    auto handler = vb::execution(vb::io_set::OUT);
+    handler.execute(vb::fs::path{ "/bin/pwd" }, {}, vb::fs::path{ test_data });
+    std::string result;
+    for (auto line : handler.lines<vb::std_io::OUT>()) {
+        result += line;
+    }
+    REQUIRE(handler.wait() == 0);
+    CHECK(result == std::string(test_data) + "\n");
+    CHECK(vb::fs::current_path() == before);
+}
+
+TEST_CASE("Concurrent execution on different working directories", "[execute][pipe][cwd][thread]")
+{
+    static constexpr auto runs = 16;
+    auto results = std::array<std::string, runs>{};
+    auto workers = std::vector<std::jthread>{};
+    for (auto index = 0; index < runs; ++index) {
+        auto dir = index % 2 == 0 ? vb::fs::path{ test_data } : vb::fs::path{ test_dir };
+        workers.emplace_back([dir, &result = results.at(static_cast<std::size_t>(index))]() {
+            auto handler = vb::execution(vb::io_set::OUT);
+            handler.execute(vb::fs::path{ "/bin/pwd" }, {}, dir);
+            for (auto line : handler.lines<vb::std_io::OUT>()) {
+                result += line;
+            }
+            handler.wait();
+        });
+    }
+    workers.clear();
+
+    for (auto index = 0; index < runs; ++index) {
+        auto dir = index % 2 == 0 ? std::string{ test_data } : std::string{ test_dir };
+        CHECK(results.at(static_cast<std::size_t>(index)) == dir + "\n");
+    }
+}
+
+TEST_CASE("Prepared command launched many times", "[execute][pipe][prepared]")
+{
+    auto command = vb::prepared_command{ vb::fs::path{ "/bin/echo" }, std::array{ "hello"s } };
+    for (auto index = 0; index < 4; ++index) {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.execute(command, std::array{ std::to_string(index) });
+        std::string result;
+        for (auto line : handler.lines<vb::std_io::OUT>()) {
+            result += line;
+        }
+        REQUIRE(handler.wait() == 0);
+        CHECK(result == "hello " + std::to_string(index) + "\n");
+    }
+
+    auto handler = vb::execution(vb::io_set::OUT);
+    handler.execute(command);
+    std::string result;
+    for (auto line : handler.lines<vb::std_io::OUT>()) {
+        result += line;
+    }
+    REQUIRE(handler.wait() == 0);
+    CHECK(result == "hello\n");
+}
+
+TEST_CASE("Execution redirected to files and descriptors", "[execute][redirect]")
+{
+    auto output = vb::fs::temp_directory_path() / "vb_execution_redirect.txt";
+
+    SECTION("stdin from a file and stdout to a file")
+    {
+        auto handler = vb::execution();
+        handler.redirect(vb::std_io::IN, vb::redirection::file(vb::fs::path{ test_data } / "abc"));
+        handler.redirect(vb::std_io::OUT, vb::redirection::file(output));
+        handler.execute(vb::fs::path{ "/bin/cat" });
+        REQUIRE(handler.wait() == 0);
+
+        auto fd     = vb::sys::open(output.c_str(), O_RDONLY);
+        auto result = std::string(16, '\0');
+        result.resize(static_cast<std::size_t>(vb::sys::pread(fd, result.data(), result.size(), 0)));
+        vb::sys::close(fd);
+        CHECK(result == "ABC\n");
+        vb::fs::remove(output);
+    }
+
+    SECTION("stdout to a memfd and stderr to /dev/null")
+    {
+        auto fd      = vb::sys::memfd_create("output", 0U);
+        auto handler = vb::execution(vb::io_set::ERR);
+        handler.redirect(vb::std_io::OUT, vb::redirection::fd(fd));
+        handler.redirect(vb::std_io::ERR, vb::redirection::null());
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "echo out; echo err >&2"s });
+        REQUIRE(handler.wait() == 0);
+
+        auto result = std::string(16, '\0');
+        result.resize(static_cast<std::size_t>(vb::sys::pread(fd, result.data(), result.size(), 0)));
+        vb::sys::close(fd);
+        CHECK(result == "out\n");
+    }
+}
+
+TEST_CASE("Execution resource usage and timing", "[execute][usage]")
+{
+    auto handler = vb::execution(vb::io_set::OUT);
+    REQUIRE_FALSE(handler.usage().has_value());
+    handler.execute(
+        vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "i=0; while [ $i -lt 2000 ]; do i=$((i+1)); done; echo done"s });
+    for (auto line : handler.lines<vb::std_io::OUT>()) {
+        CHECK(line == "done\n");
+    }
+    REQUIRE(handler.wait() == 0);
+
+    REQUIRE(handler.usage().has_value());
+    const auto& usage = handler.usage().value();
+    CHECK(usage.max_resident_kb > 0);
+    CHECK(usage.user_time + usage.system_time > vb::sys::resource_usage::duration::zero());
+
+    const auto& timing = handler.timing();
+    REQUIRE(timing.spawned.has_value());
+    REQUIRE(timing.first_output.has_value());
+    REQUIRE(timing.exited.has_value());
+    CHECK(timing.spawned.value() <= timing.first_output.value());
+    CHECK(timing.spawned.value() <= timing.exited.value());
+    CHECK(timing.wall_time().has_value());
+
+    SECTION("first byte of a partial line")
+    {
+        auto partial = vb::execution(vb::io_set::OUT);
+        partial.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "printf first; sleep 0.3; echo"s });
+        auto line = partial.next_line<vb::std_io::OUT>();
+        CHECK(line == "first\n");
+        REQUIRE(partial.wait() == 0);
+        REQUIRE(partial.timing().first_output.has_value());
+        CHECK(partial.timing().exited.value() - partial.timing().first_output.value() > 200ms);
+    }
+}
+
+TEST_CASE("Execution deadline escalates from SIGTERM to SIGKILL", "[execute][deadline]")
+{
+    SECTION("terminated child")
+    {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/bin/sleep" }, std::array{ "10"s });
+        handler.deadline(50ms, 1s);
+        for (auto line : handler.lines<vb::std_io::OUT>()) {
+            FAIL("unexpected output: " << line);
+        }
+        CHECK(handler.wait() == 128 + SIGTERM);
+        CHECK(handler.timed_out());
+    }
+    SECTION("child ignoring SIGTERM")
+    {
+        auto handler = vb::execution();
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "trap '' TERM; exec sleep 10"s });
+        handler.deadline(50ms, 50ms);
+        CHECK(handler.wait() == 128 + SIGKILL);
+        CHECK(handler.timed_out());
+    }
+    SECTION("child finishing in time")
+    {
+        auto handler = vb::execution();
+        handler.execute(vb::fs::path{ "/bin/true" });
+        handler.deadline(10s);
+        CHECK(handler.wait() == 0);
+        CHECK_FALSE(handler.timed_out());
+    }
+}
+
+TEST_CASE("Streaming stdin while reading the output", "[execute][pipe][stream]")
+{
+    SECTION("input larger than both pipe buffers")
+    {
+        static constexpr auto count = 100'000;
+        auto                  input = std::vector<std::string>{};
+        for (auto index = count; index > 0; --index) {
+            input.push_back(std::to_string(index) + "\n");
+        }
+        auto handler = vb::execution(vb::io_set::IN | vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/bin/cat" });
+
+        auto lines  = 0;
+        auto first  = std::string{};
+        auto status = handler.stream(input, [&](vb::std_io, std::string line) {
+            if (lines++ == 0) {
+                first = std::move(line);
+            }
+        });
+        CHECK(status == 0);
+        CHECK(lines == count);
+        CHECK(first == std::to_string(count) + "\n");
+    }
+    SECTION("child that stops reading")
+    {
+        auto input   = std::string(1 * vb::MB, 'x');
+        auto handler = vb::execution(vb::io_set::IN | vb::io_set::OUT | vb::io_set::ERR);
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "echo started; echo failed >&2; exit 3"s });
+
+        auto output = std::vector<std::string>{};
+        auto errors = std::vector<std::string>{};
+        auto status = handler.stream(input, [&](vb::std_io io, std::string line) {
+            (io == vb::std_io::OUT ? output : errors).push_back(std::move(line));
+        });
+        CHECK(status == 3);
+        CHECK(output == std::vector{ "started\n"s });
+        CHECK(errors == std::vector{ "failed\n"s });
+    }
+}
+
+TEST_CASE("Reading binary output in chunks", "[execute][pipe][chunks]")
+{
+    SECTION("bytes come unchanged")
+    {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/usr/bin/printf" }, std::array{ "a\\000b\\nc\\377"s });
+        auto output = std::vector<std::byte>{};
+        for (auto block : handler.chunks<vb::std_io::OUT>()) {
+            output.insert(output.end(), block.begin(), block.end());
+        }
+        CHECK(handler.wait() == 0);
+        CHECK(handler.timing().first_output.has_value());
+        CHECK(output == std::vector{ std::byte{ 'a' },
+                                     std::byte{ 0 },
+                                     std::byte{ 'b' },
+                                     std::byte{ '\n' },
+                                     std::byte{ 'c' },
+                                     std::byte{ 0xFF } });
+    }
+    SECTION("blocks reuse one buffer")
+    {
+        static constexpr auto size = std::size_t{ 1 } * vb::MB;
+
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/usr/bin/head" }, std::array{ "-c"s, std::to_string(size), "/dev/zero"s });
+        auto total   = std::size_t{ 0 };
+        auto buffers = std::set<const std::byte *>{};
+        for (auto block : handler.chunks<vb::std_io::OUT>(4 * vb::KB)) {
+            CHECK(block.size() <= 4 * vb::KB);
+            total += block.size();
+            buffers.insert(block.data());
+        }
+        CHECK(handler.wait() == 0);
+        CHECK(total == size);
+        CHECK(buffers.size() == 1);
+    }
+}
+
+TEST_CASE("Merged stdout and stderr in arrival order", "[execute][pipe][merged]")
+{
+    auto script  = "echo 1; echo 2 >&2; sleep 0.1; echo 3; sleep 0.1; echo 4 >&2; sleep 0.1; printf 5"s;
+    auto handler = vb::execution(vb::io_set::OUT | vb::io_set::ERR);
+    handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, script });
+
+    auto lines = std::vector<vb::timed_line>{};
+    for (const auto& line : handler.merged_lines()) {
+        lines.push_back(line);
+    }
+    CHECK(handler.wait() == 0);
+    REQUIRE(lines.size() == 5);
+    auto arrival = std::array{ std::pair{ vb::std_io::OUT, "1\n"s },
+                               std::pair{ vb::std_io::ERR, "2\n"s },
+                               std::pair{ vb::std_io::OUT, "3\n"s },
+                               std::pair{ vb::std_io::ERR, "4\n"s },
+                               std::pair{ vb::std_io::OUT, "5"s } };
+    for (std::size_t index = 0; index < lines.size(); ++index) {
+        CHECK(lines[index].io == arrival.at(index).first);
+        CHECK(lines[index].text == arrival.at(index).second);
+        if (index > 0) {
+            CHECK(lines[index].at >= lines[index - 1].at);
+        }
+    }
+    CHECK(lines[2].at - lines[1].at >= 50ms);
+
+    SECTION("both streams writing continuously")
+    {
+        static constexpr auto count = 100000;
+
+        auto both = "yes out | head -n " + std::to_string(count) + " & yes err | head -n " + std::to_string(count) +
+                    " >&2; wait";
+        auto writer = vb::execution(vb::io_set::OUT | vb::io_set::ERR);
+        writer.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, both });
+        auto order = std::vector<vb::std_io>{};
+        for (const auto& line : writer.merged_lines()) {
+            order.push_back(line.io);
+        }
+        CHECK(writer.wait() == 0);
+        CHECK(std::ranges::count(order, vb::std_io::OUT) == count);
+        CHECK(std::ranges::count(order, vb::std_io::ERR) == count);
+        auto first_error = std::ranges::find(order, vb::std_io::ERR) - order.begin();
+        auto last_output = std::ranges::find(order.rbegin(), order.rend(), vb::std_io::OUT).base() - order.begin();
+        CHECK(first_error < last_output);
+    }
+}
+
+TEST_CASE("Feeding stdin from a generator", "[execute][pipe][stream]")
+{
+    auto produced = 0;
+    auto rows     = [&produced](int count) -> vb::generator<std::string> {
+        for (auto index = 0; index < count; ++index) {
+            ++produced;
+            co_yield std::to_string(index) + ",row\n";
+        }
+    };
+
+    SECTION("every row reaches the child")
+    {
+        auto handler = vb::execution(vb::io_set::IN | vb::io_set::OUT);
+        handler.execute(vb::fs::path{ "/usr/bin/wc" }, std::array{ "-l"s });
+        auto output = std::string{};
+        auto status = handler.stream(rows(200'000), [&](vb::std_io, std::string line) { output += line; });
+        CHECK(status == 0);
+        CHECK(std::stoi(output) == 200'000);
+    }
+    SECTION("rows produced on the fly into a range")
+    {
+        auto to_line = [](int index) { return std::to_string(index) + "\n"; };
+        auto lines   = std::views::iota(0, 1000) | std::views::transform(to_line);
+        auto handler = vb::execution(vb::io_set::IN);
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "test $(wc -l) -eq 1000"s });
+        CHECK(handler.feed(lines) == 0);
+    }
+    SECTION("production stops with the reader")
+    {
+        auto handler = vb::execution(vb::io_set::IN);
+        handler.execute(vb::fs::path{ "/usr/bin/head" }, std::array{ "-c"s, "1"s });
+        CHECK(handler.feed(rows(10'000'000)) == 0);
+        CHECK(produced < 10'000'000);
+    }
+}
+
+TEST_CASE("Closing inherited descriptors", "[execute][pipe][fd]")
+{
+    auto fd    = vb::sys::open("/dev/null", O_RDONLY);
+    auto check = "test -e /proc/self/fd/" + std::to_string(fd) + " && echo open || echo closed";
+    auto close = GENERATE(false, true);
+
+    auto handler = vb::execution(vb::io_set::OUT);
+    if (close) {
+        handler.close_from();
+    }
+    handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, check });
+    auto output = std::vector<std::string>{};
+    for (auto line : handler.lines<vb::std_io::OUT>()) {
+        output.push_back(line);
+    }
+    CHECK(handler.wait() == 0);
+    CHECK(output == std::vector{ close ? "closed\n"s : "open\n"s });
+    vb::sys::close(fd);
+}
+
+TEST_CASE("Tee of a child output", "[execute][pipe][tee]")
+{
+    auto run = [](int target) {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.tee(vb::std_io::OUT, target);
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "echo one; echo two"s });
+        auto output = std::vector<std::string>{};
+        for (auto line : handler.lines<vb::std_io::OUT>()) {
+            output.push_back(line);
+        }
+        CHECK(handler.wait() == 0);
+        CHECK(output == std::vector{ "one\n"s, "two\n"s });
+    };
+    auto forwarded = std::string(64, '\0');
+
+    SECTION("to a pipe, through tee(2)")
+    {
+        auto target = vb::sys::pipe();
+        REQUIRE(vb::sys::is_fifo(target[1]));
+        run(target[1]);
+        vb::sys::close(target[1]);
+        forwarded.resize(static_cast<std::size_t>(vb::sys::read(target[0], forwarded.data(), forwarded.size())));
+        vb::sys::close(target[0]);
+    }
+    SECTION("to a file")
+    {
+        auto target = vb::sys::memfd_create("tee", 0U);
+        REQUIRE_FALSE(vb::sys::is_fifo(target));
+        run(target);
+        forwarded.resize(static_cast<std::size_t>(vb::sys::pread(target, forwarded.data(), forwarded.size(), 0)));
+        vb::sys::close(target);
+    }
+    CHECK(forwarded == "one\ntwo\n");
+}
+
+TEST_CASE("Capturing the tail of a child output", "[execute][pipe][ring]")
+{
+    auto handler = vb::execution(vb::io_set::OUT);
+    handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "seq 1 100000"s });
+    auto tail = vb::ring_buffer_type<64>{};
+    handler.capture_tail<vb::std_io::OUT>(tail);
+    CHECK(handler.wait() == 0);
+    CHECK(tail.size() == 64);
+    CHECK(tail.last_lines(3) == std::vector{ "99998\n"s, "99999\n"s, "100000\n"s });
+}
+
+TEST_CASE("Scheduling, affinity and nice value of a child", "[execute][sched]")
+{
+    // Fields 19 and 41 of /proc/<pid>/stat, awk inherits them from the spawned shell.
+    auto stat = [](vb::execution& handler, const std::string& field) {
+        auto script = "awk '{ print $" + field + " }' /proc/self/stat";
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, script });
+        auto output = std::vector<std::string>{};
+        for (auto line : handler.lines<vb::std_io::OUT>()) {
+            output.push_back(line);
+        }
+        CHECK(handler.wait() == 0);
+        return output;
+    };
+
+    SECTION("scheduling policy")
+    {
+        auto policy  = GENERATE(SCHED_OTHER, SCHED_BATCH);
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.scheduling(policy);
+        CHECK(stat(handler, "41") == std::vector{ std::to_string(policy) + "\n" });
+    }
+    SECTION("nice value")
+    {
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.nice(::getpriority(PRIO_PROCESS, 0) + 5);
+        CHECK(stat(handler, "19") == std::vector{ std::to_string(::getpriority(PRIO_PROCESS, 0) + 5) + "\n" });
+    }
+    SECTION("affinity")
+    {
+        auto allowed = cpu_set_t{};
+        REQUIRE(::sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+        auto cpu = 0;
+        while (!CPU_ISSET(static_cast<std::size_t>(cpu), &allowed)) {
+            ++cpu;
+        }
+
+        auto handler = vb::execution(vb::io_set::OUT);
+        handler.affinity(std::array{ cpu });
+        auto script = "awk '/^Cpus_allowed_list/ { print $2 }' /proc/self/status"s;
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, script });
+        auto output = std::vector<std::string>{};
+        for (auto line : handler.lines<vb::std_io::OUT>()) {
+            output.push_back(line);
+        }
+        CHECK(handler.wait() == 0);
+        CHECK(output == std::vector{ std::to_string(cpu) + "\n" });
+
+        auto after = cpu_set_t{};
+        REQUIRE(::sched_getaffinity(0, sizeof(after), &after) == 0);
+        CHECK(CPU_EQUAL(&after, &allowed));
+    }
+}
+
+TEST_CASE("PATH resolution cache", "[execute][path]")
+{
+    auto directory = vb::fs::temp_directory_path() / "vb_path_cache";
+    auto first     = directory / "first";
+    auto second    = directory / "second";
+    vb::fs::create_directories(first);
+    vb::fs::create_directories(second);
+    auto install = [](const vb::fs::path& dir) {
+        auto tool = dir / "vb_tool";
+        vb::fs::copy_file("/bin/true", tool, vb::fs::copy_options::overwrite_existing);
+        return tool;
+    };
+
+    const auto *old_path = std::getenv("PATH");
+    auto        saved    = std::string{ old_path == nullptr ? "" : old_path };
+    ::setenv("PATH", (first.string() + ":" + second.string() + ":" + saved).c_str(), 1);
+
+    auto cache = vb::sys::path_cache{ 0s };
+    CHECK_FALSE(cache.resolve("vb_tool").has_value());
+    CHECK_FALSE(cache.resolve("./vb_tool").has_value());
+    auto in_second = install(second);
+    CHECK(cache.resolve("vb_tool") == in_second);
+
+    // A new executable earlier in $PATH changes the modification time of its directory.
+    auto in_first = install(first);
+    CHECK(cache.resolve("vb_tool") == in_first);
+
+    ::setenv("PATH", second.string().c_str(), 1);
+    CHECK(cache.resolve("vb_tool") == in_second);
+
+    ::setenv("PATH", (first.string() + ":" + saved).c_str(), 1);
+    auto command = vb::prepared_command{ vb::fs::path{ "vb_tool" } };
+    CHECK(command.lookup() == vb::sys::lookup::NO_LOOKUP);
+    CHECK(command.path() == in_first.string());
+    auto handler = vb::execution();
+    handler.execute(command);
+    CHECK(handler.wait() == 0);
+
+    ::setenv("PATH", saved.c_str(), 1);
+    vb::fs::remove_all(directory);
+}
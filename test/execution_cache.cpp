@@ -0,0 +1,125 @@
+// execution_cache.cpp                                                                        -*-C++-*-
+#include "util/execution_cache.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+struct counted_command
+{
+    vb::fs::path directory = vb::fs::temp_directory_path() / "vb_execution_cache";
+    vb::fs::path counter   = directory / "runs";
+    std::string  script    = "echo run >> " + counter.string() + "; echo \"out $1\"; echo err >&2; exit 3";
+
+    counted_command() { vb::fs::create_directories(directory); }
+
+    counted_command(const counted_command&)            = delete;
+    counted_command(counted_command&&)                 = delete;
+    counted_command& operator=(const counted_command&) = delete;
+    counted_command& operator=(counted_command&&)      = delete;
+
+    ~counted_command() { vb::fs::remove_all(directory); }
+
+    auto args(const std::string& value) const { return std::array{ "-c"s, script, "sh"s, value }; }
+
+    auto runs() const
+    {
+        auto file  = std::ifstream{ counter };
+        auto count = 0;
+        for (auto line = std::string{}; std::getline(file, line);) {
+            ++count;
+        }
+        return count;
+    }
+};
+
+}
+
+TEST_CASE("Execution cache hits skip the process", "[execute][cache]")
+{
+    auto command = counted_command{};
+    auto cache   = vb::execution_cache{};
+
+    const auto& first = cache.run(vb::fs::path{ "/bin/sh" }, command.args("a"));
+    CHECK(first.status == 3);
+    CHECK(first.out == "out a\n");
+    CHECK(first.err == "err\n");
+
+    const auto& second = cache.run(vb::fs::path{ "/bin/sh" }, command.args("a"));
+    CHECK(&second == &first);
+    CHECK(command.runs() == 1);
+    CHECK(cache.hits() == 1);
+
+    CHECK(cache.run(vb::fs::path{ "/bin/sh" }, command.args("b")).out == "out b\n");
+    CHECK(cache.run(vb::fs::path{ "sh" }, command.args("b"), {}, command.directory).out == "out b\n");
+    CHECK(command.runs() == 3);
+    CHECK(cache.misses() == 3);
+}
+
+TEST_CASE("Execution cache key", "[execute][cache]")
+{
+    auto cache   = vb::execution_cache{ { "LANG" } };
+    auto args    = std::array{ "-c"s, "true"s };
+    auto english = vb::env::environment{};
+    english.set("LANG") = "en";
+    auto french = vb::env::environment{};
+    french.set("LANG") = "fr";
+    auto other = english;
+    other.set("UNRELATED") = 1;
+
+    auto key = cache.key(vb::fs::path{ "/bin/sh" }, args, english);
+    CHECK(key == cache.key(vb::fs::path{ "/bin/sh" }, args, english));
+    CHECK(key == cache.key(vb::fs::path{ "/bin/sh" }, args, other));
+    CHECK(key != cache.key(vb::fs::path{ "/bin/sh" }, args, french));
+    CHECK(key != cache.key(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "false"s }, english));
+    CHECK(key != cache.key(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "tr"s, "ue"s }, english));
+    CHECK(key != cache.key(vb::fs::path{ "/bin/sh" }, args, english, vb::fs::path{ "/" }));
+}
+
+TEST_CASE("Execution cache on disk", "[execute][cache]")
+{
+    auto command = counted_command{};
+    auto store   = command.directory / "store";
+    {
+        auto cache = vb::execution_cache{ {}, store };
+        CHECK(cache.run(vb::fs::path{ "/bin/sh" }, command.args("disk")).out == "out disk\n");
+    }
+    auto        cache  = vb::execution_cache{ {}, store };
+    const auto& result = cache.run(vb::fs::path{ "/bin/sh" }, command.args("disk"));
+    CHECK(result.status == 3);
+    CHECK(result.out == "out disk\n");
+    CHECK(result.err == "err\n");
+    CHECK(cache.hits() == 1);
+    CHECK(command.runs() == 1);
+}
+
+TEST_CASE("Execution cache store entry of other fields", "[execute][cache]")
+{
+    auto command = counted_command{};
+    auto store   = command.directory / "store";
+    {
+        auto cache = vb::execution_cache{ {}, store };
+        CHECK(cache.run(vb::fs::path{ "/bin/sh" }, command.args("one")).out == "out one\n");
+    }
+    // The file of "one" under the name of "two" stands for a hash collision.
+    auto cache = vb::execution_cache{ {}, store };
+    auto name  = std::ostringstream{};
+    name << std::hex << std::setw(16) << std::setfill('0') << cache.key(vb::fs::path{ "/bin/sh" }, command.args("two"));
+    auto stored = std::vector<vb::fs::path>{ vb::fs::directory_iterator{ store }, vb::fs::directory_iterator{} };
+    REQUIRE(stored.size() == 1);
+    vb::fs::rename(stored.front(), store / name.str());
+
+    CHECK(cache.run(vb::fs::path{ "/bin/sh" }, command.args("two")).out == "out two\n");
+    CHECK(cache.misses() == 1);
+    CHECK(command.runs() == 2);
+}
@@ -114,6 +114,14 @@ TEST_CASE("pipe writing and reading", "[pipe][generator][buffer]")
         REQUIRE(*pipe_test() == std::string("4 5 6\n"));
         REQUIRE_FALSE(pipe_test.has_data());
     }
+
+    SECTION("Empty raw read keeps the pipe open")
+    {
+        pipe_test("Test");
+        REQUIRE(pipe_test.read_some({}) == 0);
+        REQUIRE_FALSE(pipe_test.closed());
+        REQUIRE(*pipe_test() == std::string("Test\n"));
+    }
 }
 
 TEST_CASE("Read loop", "[pipe][buffer][generator]")
@@ -0,0 +1,98 @@
+// pipe_set.cpp                                                                        -*-C++-*-
+#include "util/pipe_set.hpp"
+
+#include "util/execution.hpp"
+#include "util/pipe.hpp"
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+TEST_CASE("Pipe set only touches the ready pipes", "[pipe_set][pipe]")
+{
+    static constexpr auto count = std::size_t{ 500 };
+
+    auto pipes    = std::vector<std::unique_ptr<vb::pipe>>{};
+    auto received = std::vector<std::pair<std::size_t, std::string>>{};
+    auto set      = vb::pipe_set{};
+    for (std::size_t index = 0; index < count; ++index) {
+        pipes.push_back(std::make_unique<vb::pipe>());
+        set.add(*pipes.back(), [&received, index](std::string line) { received.emplace_back(index, std::move(line)); });
+    }
+    CHECK(set.size() == count);
+    CHECK(set.poll(0ms) == 0);
+
+    (*pipes[123])("one");
+    (*pipes[321])("two", "three");
+    CHECK(set.poll(1s) == 2);
+    CHECK(std::set(received.begin(), received.end()) ==
+          std::set{ std::pair{ std::size_t{ 123 }, "one\n"s },
+                    std::pair{ std::size_t{ 321 }, "two\n"s },
+                    std::pair{ std::size_t{ 321 }, "three\n"s } });
+}
+
+TEST_CASE("Pipe set delivers the last partial line and the end", "[pipe_set][pipe]")
+{
+    auto source = vb::pipe{};
+    auto lines  = std::vector<std::string>{};
+    auto ended  = false;
+    auto set    = vb::pipe_set{};
+    set.add(source, [&lines](std::string line) { lines.push_back(std::move(line)); }, [&ended] { ended = true; });
+
+    vb::sys::write_all(source.get_fd(vb::io_direction::WRITE), "a\nb");
+    CHECK(set.poll(1s) == 1);
+    CHECK(lines == std::vector{ "a\n"s });
+    source.close<vb::io_direction::WRITE>();
+    set.run();
+    CHECK(lines == std::vector{ "a\n"s, "b"s });
+    CHECK(ended);
+    CHECK(set.empty());
+}
+
+TEST_CASE("Pipe set removal from a callback", "[pipe_set][pipe]")
+{
+    auto source = vb::pipe{};
+    auto lines  = std::vector<std::string>{};
+    auto set    = vb::pipe_set{};
+    set.add(source, [&](std::string line) {
+        lines.push_back(std::move(line));
+        set.remove(source);
+    });
+    source("first", "second");
+    CHECK(set.poll(1s) == 1);
+    CHECK(lines == std::vector{ "first\n"s });
+    CHECK(set.empty());
+    CHECK(source() == "second\n");
+}
+
+TEST_CASE("Pipe set supervises many children", "[pipe_set][execute]")
+{
+    static constexpr auto count = 100;
+
+    auto children = std::vector<std::unique_ptr<vb::execution>>{};
+    auto outputs  = std::vector<std::string>(count);
+    auto finished = 0;
+    auto set      = vb::pipe_set{};
+    for (auto index = 0; index < count; ++index) {
+        auto& child = *children.emplace_back(std::make_unique<vb::execution>(vb::io_set::OUT));
+        child.execute(vb::fs::path{ "/bin/echo" }, std::array{ std::to_string(index) });
+        child.watch(
+            set,
+            vb::std_io::OUT,
+            [&outputs, index](std::string line) { outputs[static_cast<std::size_t>(index)] += line; },
+            [&finished] { ++finished; });
+    }
+    set.run();
+    CHECK(finished == count);
+    for (auto index = 0; index < count; ++index) {
+        CHECK(outputs[static_cast<std::size_t>(index)] == std::to_string(index) + "\n");
+        CHECK(children[static_cast<std::size_t>(index)]->wait() == 0);
+    }
+}
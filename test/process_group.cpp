@@ -0,0 +1,125 @@
+// process_group.cpp                                                                        -*-C++-*-
+#include "util/process_group.hpp"
+
+#include "util/command.hpp"
+#include <catch2/catch_all.hpp>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+
+namespace {
+
+// A zombie waiting for its new parent to reap it counts as gone too.
+auto
+gone(pid_t pid) -> bool
+{
+    if (::kill(pid, 0) != 0) {
+        return true;
+    }
+    auto stat = std::ifstream{ "/proc/" + std::to_string(pid) + "/stat" };
+    auto line = std::string{};
+    std::getline(stat, line);
+    auto end = line.rfind(')');
+    return end != std::string::npos && end + 2 < line.size() && line[end + 2] == 'Z';
+}
+
+}
+
+TEST_CASE("Process group members share the group of the first one", "[process_group][execute]")
+{
+    auto group = vb::process_group{};
+    for (auto index = 0; index < 3; ++index) {
+        group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/sleep" }, std::array{ "0.1"s });
+    }
+    CHECK(group.size() == 3);
+    CHECK(group.id() == group[0].get_pid());
+    for (std::size_t index = 0; index < group.size(); ++index) {
+        CHECK(::getpgid(group[index].get_pid()) == group.id());
+    }
+    CHECK(group.wait() == std::vector{ 0, 0, 0 });
+    CHECK(group.poll() == 0);
+    CHECK(group[1].usage().has_value());
+}
+
+TEST_CASE("Process group is cancelled with one signal", "[process_group][execute]")
+{
+    constexpr auto MEMBERS = 100;
+
+    auto group = vb::process_group{};
+    for (auto index = 0; index < MEMBERS; ++index) {
+        group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/sleep" }, std::array{ "30"s });
+    }
+    CHECK(group.poll() == MEMBERS);
+
+    auto start = std::chrono::steady_clock::now();
+    group.signal(SIGTERM);
+    auto statuses = group.wait();
+    CHECK(std::chrono::steady_clock::now() - start < 10s);
+    CHECK(statuses == std::vector(MEMBERS, 128 + SIGTERM));
+    CHECK(group.poll() == 0);
+}
+
+TEST_CASE("Process group signal reaches grandchildren", "[process_group][execute]")
+{
+    auto  group  = vb::process_group{};
+    auto& parent = group.execute(
+        vb::io_set::OUT, vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "sleep 30 & echo $!; wait"s });
+    auto line = parent.next_line<vb::std_io::OUT>();
+    REQUIRE(line.has_value());
+    auto grandchild = std::stoi(line.value());
+    CHECK(::getpgid(grandchild) == group.id());
+
+    group.signal(SIGKILL);
+    CHECK(group.wait() == std::vector{ 128 + SIGKILL });
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!gone(grandchild) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    CHECK(gone(grandchild));
+}
+
+TEST_CASE("Process group waits for members that already exited", "[process_group][execute]")
+{
+    auto group = vb::process_group{};
+    group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "exit 3"s });
+    group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, "sleep 0.2; exit 4"s });
+    CHECK(group[0].wait() == 3);
+    CHECK(group.wait() == std::vector{ 3, 4 });
+}
+
+TEST_CASE("Process group members from a prepared command", "[process_group][execute][prepared]")
+{
+    auto command = vb::prepared_command{ vb::fs::path{ "/bin/sleep" }, std::array{ "30"s } };
+    auto group   = vb::process_group{};
+    for (auto index = 0; index < 3; ++index) {
+        group.execute(vb::io_set::NONE, command);
+    }
+    for (std::size_t index = 0; index < group.size(); ++index) {
+        CHECK(::getpgid(group[index].get_pid()) == group.id());
+    }
+    group.signal(SIGTERM);
+    CHECK(group.wait() == std::vector(3, 128 + SIGTERM));
+}
+
+TEST_CASE("Process group is forgotten once every member was reaped", "[process_group][execute]")
+{
+    auto group = vb::process_group{};
+    group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/true" });
+    CHECK(group.wait() == std::vector{ 0 });
+    CHECK(group.id() == -1);
+    group.signal(SIGKILL);
+
+    auto& next = group.execute(vb::io_set::NONE, vb::fs::path{ "/bin/sleep" }, std::array{ "0.1"s });
+    CHECK(group.id() == next.get_pid());
+    CHECK(::getpgid(next.get_pid()) == group.id());
+    CHECK(group.wait() == std::vector{ 0, 0 });
+}
@@ -0,0 +1,119 @@
+// reactor.cpp                                                                        -*-C++-*-
+#include "util/execution.hpp"
+#include "util/reactor.hpp"
+#include "util/task.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+struct echo_result
+{
+    std::string output{};
+    int         status{ -1 };
+};
+
+vb::task<void>
+echo(vb::reactor& loop, int index, echo_result& result)
+{
+    auto handler = vb::execution(vb::io_set::OUT);
+    handler.execute(vb::fs::path{ "/bin/echo" }, std::array{ std::to_string(index) });
+    while (auto line = co_await handler.next_line<vb::std_io::OUT>(loop)) {
+        result.output += line.value();
+    }
+    result.status = co_await handler.wait(loop);
+}
+
+vb::task<void>
+round_trip(vb::reactor& loop, vb::execution& handler, std::vector<std::string>& output, int& status)
+{
+    co_await handler.writable(loop);
+    handler.send("ping");
+    handler.done(vb::std_io::IN);
+    while (auto line = co_await handler.next_line<vb::std_io::OUT>(loop)) {
+        output.push_back(line.value());
+    }
+    status = co_await handler.wait(loop);
+}
+
+vb::task<void>
+ticker(vb::reactor& loop, std::chrono::milliseconds delay, std::vector<int>& order, int id)
+{
+    co_await loop.sleep_for(delay);
+    order.push_back(id);
+}
+
+vb::task<int>
+answer()
+{
+    co_return 42;
+}
+
+vb::task<void>
+nested(int& result)
+{
+    result = co_await answer();
+}
+
+}
+
+TEST_CASE("Task awaiting another task", "[task]")
+{
+    auto result = 0;
+    auto job    = nested(result);
+    job.start();
+    REQUIRE(job.done());
+    CHECK(result == 42);
+}
+
+TEST_CASE("Reactor timers", "[reactor][task]")
+{
+    auto loop  = vb::reactor{};
+    auto order = std::vector<int>{};
+    loop.spawn(ticker(loop, 20ms, order, 2));
+    loop.spawn(ticker(loop, 1ms, order, 1));
+    loop.spawn(ticker(loop, 40ms, order, 3));
+    loop.run();
+    CHECK(order == std::vector{ 1, 2, 3 });
+}
+
+TEST_CASE("Many executions on one reactor", "[reactor][execute][pipe]")
+{
+    static constexpr auto count   = 64;
+    auto                  loop    = vb::reactor{};
+    auto                  results = std::vector<echo_result>(count);
+    for (auto index = 0; index < count; ++index) {
+        loop.spawn(echo(loop, index, results.at(static_cast<std::size_t>(index))));
+    }
+    REQUIRE(loop.pending() == count);
+    loop.run();
+
+    for (auto index = 0; index < count; ++index) {
+        const auto& result = results.at(static_cast<std::size_t>(index));
+        CHECK(result.output == std::to_string(index) + "\n");
+        CHECK(result.status == 0);
+    }
+}
+
+TEST_CASE("Awaiting a writable stdin", "[reactor][execute][pipe]")
+{
+    auto loop    = vb::reactor{};
+    auto handler = vb::execution(vb::io_set::IN | vb::io_set::OUT);
+    handler.execute(vb::fs::path{ "/bin/cat" });
+
+    auto output = std::vector<std::string>{};
+    auto status = -1;
+    loop.spawn(round_trip(loop, handler, output, status));
+    loop.run();
+
+    CHECK(output == std::vector{ "ping\n"s });
+    CHECK(status == 0);
+}
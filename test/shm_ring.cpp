@@ -0,0 +1,164 @@
+// shm_ring.cpp                                                                        -*-C++-*-
+#include "util/shm_ring.hpp"
+
+#include "util/execution.hpp"
+#include "util/system.hpp"
+#include <catch2/catch_all.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std::literals;
+
+TEST_CASE("Shared memory ring lines", "[shm_ring][pipe]")
+{
+    auto ring = vb::shm_ring::create();
+    CHECK(ring.capacity() == vb::shm_ring::DEFAULT_CAPACITY);
+    CHECK_FALSE(ring.has_data());
+
+    ring("first", 2);
+    ring.write("par");
+    CHECK(ring.next_line() == "first\n");
+    CHECK(ring.next_line() == "2\n");
+    CHECK_FALSE(ring().has_value());
+    ring.write("tial");
+    ring.close_write();
+    CHECK(ring.next_line() == "partial");
+    CHECK(ring.next_line() == std::nullopt);
+    CHECK(ring.closed());
+}
+
+TEST_CASE("Shared memory ring wraps around", "[shm_ring][pipe]")
+{
+    static constexpr auto count = 100'000;
+
+    auto ring   = vb::shm_ring::create(vb::sys::PAGE_SIZE);
+    auto writer = std::jthread{ [&ring] {
+        for (auto index = 0; index < count; ++index) {
+            ring(index);
+        }
+        ring.close_write();
+    } };
+
+    auto expected = 0;
+    for (auto line = ring.next_line(); line.has_value(); line = ring.next_line()) {
+        if (line.value() != std::to_string(expected) + "\n") {
+            break;
+        }
+        ++expected;
+    }
+    CHECK(expected == count);
+}
+
+TEST_CASE("Shared memory ring between processes", "[shm_ring][fd]")
+{
+    auto ring = vb::shm_ring::create(vb::sys::PAGE_SIZE);
+    auto pid  = vb::sys::fork();
+    if (pid == 0) {
+        auto child = vb::shm_ring::attach(::dup(ring.get_fd()));
+        auto chunk = std::string(1000, 'x') + "\n";
+        for (auto index = 0; index < 1000; ++index) {
+            child.write(chunk);
+        }
+        child.close_write();
+        ::_exit(0);
+    }
+
+    auto buffer = std::array<char, 4096>{};
+    auto total  = std::size_t{ 0 };
+    for (auto size = ring.read(buffer); size > 0; size = ring.read(buffer)) {
+        total += size;
+    }
+    CHECK(total == 1001 * 1000);
+    CHECK(vb::sys::wait_pid(pid) == 0);
+}
+
+TEST_CASE("Shared memory ring to an executed child", "[shm_ring][execute]")
+{
+    auto ring    = vb::shm_ring::create(vb::sys::PAGE_SIZE);
+    auto handler = vb::execution{};
+    handler.redirect(vb::std_io::IN, vb::redirection::fd(ring.get_fd()));
+    handler.redirect(vb::std_io::OUT, vb::redirection::null());
+    // The test binary itself plays the child, see the hidden case below.
+    handler.execute(vb::fs::read_symlink("/proc/self/exe"), std::array{ "Shared memory ring writer child"s });
+    ring.peer(handler.get_pid());
+
+    auto expected = 0;
+    for (auto line = ring.next_line(); line.has_value(); line = ring.next_line()) {
+        if (line.value() != std::to_string(expected) + "\n") {
+            break;
+        }
+        ++expected;
+    }
+    CHECK(expected == 1000);
+    CHECK(handler.wait() == 0);
+}
+
+TEST_CASE("Shared memory ring writer child", "[.][shm_ring_child]")
+{
+    auto ring = vb::shm_ring::attach(::dup(STDIN_FILENO));
+    for (auto index = 0; index < 1000; ++index) {
+        ring(index);
+    }
+    ring.close_write();
+}
+
+TEST_CASE("Shared memory ring ends when the writer dies", "[shm_ring][fd]")
+{
+    auto ring = vb::shm_ring::create(vb::sys::PAGE_SIZE);
+    auto pid  = vb::sys::fork();
+    if (pid == 0) {
+        auto child = vb::shm_ring::attach(::dup(ring.get_fd()));
+        child.write("unfinished");
+        ::_exit(1);
+    }
+
+    // The child is not reaped before the ring sees it gone.
+    CHECK(ring.next_line() == "unfinished");
+    CHECK(ring.next_line() == std::nullopt);
+    CHECK(vb::sys::wait_pid(pid) == 1);
+}
+
+TEST_CASE("Shared memory ring ends when the child exits before attaching", "[shm_ring][execute]")
+{
+    auto ring    = vb::shm_ring::create(vb::sys::PAGE_SIZE);
+    auto handler = vb::execution{};
+    handler.redirect(vb::std_io::IN, vb::redirection::fd(ring.get_fd()));
+    handler.execute(vb::fs::path{ "/bin/false" });
+    ring.peer(handler.get_pid());
+
+    CHECK(ring.next_line() == std::nullopt);
+    CHECK(handler.wait() == 1);
+}
+
+TEST_CASE("Shared memory ring throughput", "[.][benchmark][shm_ring]")
+{
+    static constexpr auto size  = std::size_t{ 4 } * vb::GB;
+    static constexpr auto block = std::size_t{ 64 } * vb::KB;
+
+    auto ring   = vb::shm_ring::create();
+    auto start  = std::chrono::steady_clock::now();
+    auto writer = std::jthread{ [&ring] {
+        auto chunk = std::string(block, 'x');
+        for (auto written = std::size_t{ 0 }; written < size; written += chunk.size()) {
+            ring.write(chunk);
+        }
+        ring.close_write();
+    } };
+
+    auto buffer = std::string(block, '\0');
+    auto total  = std::size_t{ 0 };
+    for (auto read = ring.read(buffer); read > 0; read = ring.read(buffer)) {
+        total += read;
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "shm_ring: " << static_cast<double>(total) / static_cast<double>(vb::GB) / seconds << "GB/s\n";
+    CHECK(total == size);
+}
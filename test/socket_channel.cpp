@@ -0,0 +1,127 @@
+// socket_channel.cpp                                                                        -*-C++-*-
+#include "util/socket_channel.hpp"
+
+#include "util/execution.hpp"
+#include "util/system.hpp"
+#include <catch2/catch_all.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+TEST_CASE("Socket channel lines in both directions", "[socket][pipe]")
+{
+    auto [local, remote] = vb::socket_pair();
+    local("ping", 42);
+    CHECK(remote.next_line() == "ping\n");
+    CHECK(remote.next_line() == "42\n");
+    remote("pong");
+    CHECK(local.next_line() == "pong\n");
+
+    SECTION("partial line at the end")
+    {
+        remote.send("last");
+        CHECK_FALSE(local().has_value());
+        remote.close();
+        CHECK(local.next_line() == "last");
+        CHECK(local.next_line() == std::nullopt);
+        CHECK(local.closed());
+    }
+}
+
+TEST_CASE("Socket channel as stdin and stdout of a child", "[socket][execute]")
+{
+    auto [local, remote] = vb::socket_pair();
+    auto handler         = vb::execution();
+    handler.redirect(vb::std_io::IN, vb::redirection::fd(remote.get_fd()));
+    handler.redirect(vb::std_io::OUT, vb::redirection::fd(remote.get_fd()));
+
+    SECTION("conversation")
+    {
+        auto script = "while read l; do echo \"got $l\"; done"s;
+        handler.execute(vb::fs::path{ "/bin/sh" }, std::array{ "-c"s, script });
+        remote.close();
+        for (auto index = 0; index < 10; ++index) {
+            local(index);
+            CHECK(local.next_line() == "got " + std::to_string(index) + "\n");
+        }
+        local.shutdown_write();
+        CHECK(local.next_line() == std::nullopt);
+    }
+    SECTION("answer after the end of the input")
+    {
+        handler.execute(vb::fs::path{ "/usr/bin/wc" }, std::array{ "-l"s });
+        remote.close();
+        local("a", "b", "c");
+        local.shutdown_write();
+        auto count = local.next_line();
+        REQUIRE(count.has_value());
+        CHECK(std::stoi(count.value()) == 3);
+    }
+    CHECK(handler.wait() == 0);
+}
+
+TEST_CASE("Socket channel keeps message boundaries", "[socket]")
+{
+    auto [local, remote] = vb::socket_pair(SOCK_SEQPACKET);
+    remote.send("first");
+    remote.send("second message");
+
+    auto buffer = std::array<char, 64>{};
+    auto first  = local.receive(buffer);
+    CHECK(std::string_view{ buffer.data(), first.size } == "first");
+    auto second = local.receive(buffer);
+    CHECK(std::string_view{ buffer.data(), second.size } == "second message");
+    CHECK(second.fds.empty());
+
+    SECTION("message too big for the buffer")
+    {
+        remote.send("more than four bytes");
+        auto small = std::array<char, 4>{};
+        CHECK_THROWS_AS(local.receive(small), std::runtime_error);
+    }
+    SECTION("empty raw read keeps the next message")
+    {
+        remote.send("third");
+        remote.send("fourth");
+        CHECK(local.read_some({}) == 0);
+        auto third = local.receive(buffer);
+        CHECK(std::string_view{ buffer.data(), third.size } == "third");
+    }
+    SECTION("descriptors sent to a line read")
+    {
+        auto file = vb::sys::pipe();
+        remote.send("line\n", std::array{ file[0] });
+        CHECK_THROWS_AS(local(), std::runtime_error);
+        vb::sys::close(file[0]);
+        vb::sys::close(file[1]);
+    }
+}
+
+TEST_CASE("Socket channel passes descriptors", "[socket][fd]")
+{
+    auto [local, remote] = vb::socket_pair(SOCK_SEQPACKET);
+    auto file            = vb::sys::pipe();
+    vb::sys::write_all(file[1], "through the pipe\n");
+
+    local.send("file", std::array{ file[0] });
+    vb::sys::close(file[0]);
+
+    auto buffer   = std::array<char, 16>{};
+    auto received = remote.receive(buffer);
+    CHECK(std::string_view{ buffer.data(), received.size } == "file");
+    REQUIRE(received.fds.size() == 1);
+
+    auto content = std::array<char, 32>{};
+    auto size    = vb::sys::read(received.fds[0], content.data(), content.size());
+    CHECK(std::string_view{ content.data(), static_cast<std::size_t>(size) } == "through the pipe\n");
+    vb::sys::close(received.fds[0]);
+    vb::sys::close(file[1]);
+}
@@ -0,0 +1,229 @@
+// spawn_benchmark.cpp                                                                        -*-C++-*-
+#include "util/buffer.hpp"
+#include "util/execution.hpp"
+#include "util/system.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+auto
+spawn_true(vb::sys::spawn_mode mode)
+{
+    auto spawner = vb::sys::spawn{};
+    spawner.mode(mode);
+    spawner(vb::sys::lookup::NO_LOOKUP, std::array{ "/bin/true"s });
+    return vb::sys::wait_pid(spawner.get_pid());
+}
+
+auto
+fork_true()
+{
+    auto pid = vb::sys::fork();
+    if (pid == 0) {
+        ::execl("/bin/true", "/bin/true", nullptr);
+        ::_exit(127);
+    }
+    return vb::sys::wait_pid(pid);
+}
+
+using clock    = std::chrono::steady_clock;
+using duration = std::chrono::duration<double, std::micro>;
+
+// Catch only reports mean and deviation, the tail matters as much for spawning.
+void
+report(std::string_view name, std::vector<duration> samples)
+{
+    std::ranges::sort(samples);
+    auto at = [&samples](std::size_t percent) {
+        return samples.at((samples.size() - 1) * percent / 100).count();
+    };
+    std::cout << name << ": p50 " << at(50) << "us, p90 " << at(90) << "us, p99 " << at(99) << "us, max "
+              << samples.back().count() << "us over " << samples.size() << " runs\n";
+}
+
+auto
+execute_true()
+{
+    auto handler = vb::execution();
+    handler.execute(vb::fs::path{ "/bin/true" });
+    return handler.wait();
+}
+
+enum class reader : std::uint8_t
+{
+    LINES,
+    CHUNKS,
+    MERGED
+};
+
+// Bytes per second of `args` output read through lines<OUT>(), chunks<OUT>() or merged_lines().
+auto
+read_throughput(std::string_view name, const std::vector<std::string>& args, reader through = reader::LINES)
+{
+    auto handler = vb::execution(vb::io_set::OUT | vb::io_set::ERR);
+    auto start   = clock::now();
+    handler.execute(vb::fs::path{ "/bin/sh" }, args);
+    auto bytes = std::size_t{ 0 };
+    switch (through) {
+    case reader::LINES:
+        for (const auto& line : handler.lines<vb::std_io::OUT>()) {
+            bytes += line.size();
+        }
+        break;
+    case reader::CHUNKS:
+        for (auto block : handler.chunks<vb::std_io::OUT>()) {
+            bytes += block.size();
+        }
+        break;
+    case reader::MERGED:
+        for (const auto& line : handler.merged_lines()) {
+            bytes += line.text.size();
+        }
+        break;
+    }
+    auto status  = handler.wait();
+    auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << name << ": " << static_cast<double>(bytes) / static_cast<double>(vb::MB) / seconds << "MB/s\n";
+    CHECK(status == 0);
+    return bytes;
+}
+
+}
+
+// Run with: basic_utils_test "[benchmark]"
+TEST_CASE("Spawn cost against the parent memory size", "[.][benchmark][spawn]")
+{
+    auto resident_mb = GENERATE(std::size_t{ 0 }, std::size_t{ 256 }, std::size_t{ 1024 });
+    // Touch every page so that it is really part of the resident set.
+    auto ballast = std::vector<char>(resident_mb * vb::MB, 1);
+    auto suffix  = " with " + std::to_string(resident_mb) + "MB resident";
+
+    BENCHMARK("posix_spawn" + suffix)
+    {
+        return spawn_true(vb::sys::spawn_mode::DEFAULT);
+    };
+
+    // glibc ignores POSIX_SPAWN_USEVFORK, it always spawns with clone(CLONE_VM | CLONE_VFORK).
+#ifdef __GLIBC__
+    BENCHMARK("posix_spawn vfork, the same as posix_spawn on glibc," + suffix)
+#else
+    BENCHMARK("posix_spawn vfork" + suffix)
+#endif
+    {
+        return spawn_true(vb::sys::spawn_mode::VFORK);
+    };
+
+    BENCHMARK("fork + exec" + suffix)
+    {
+        return fork_true();
+    };
+
+    CHECK(ballast.size() == resident_mb * vb::MB);
+}
+
+TEST_CASE("Spawn to exit latency", "[.][benchmark][spawn][execute]")
+{
+    static constexpr auto runs = 1000;
+
+    auto samples = std::vector<duration>{};
+    samples.reserve(runs);
+    for (auto run = 0; run < runs; ++run) {
+        auto start = clock::now();
+        CHECK(execute_true() == 0);
+        samples.emplace_back(clock::now() - start);
+    }
+    report("execute /bin/true + wait", std::move(samples));
+
+    BENCHMARK("execute /bin/true + wait")
+    {
+        return execute_true();
+    };
+}
+
+TEST_CASE("Sustained spawns with concurrent children", "[.][benchmark][spawn][execute]")
+{
+    static constexpr auto total      = 2000;
+    auto                  concurrent = GENERATE(1, 4, 16, 64);
+
+    // Launch time of every child still running, each one is replaced as soon as it is reaped.
+    auto running  = std::unordered_map<pid_t, clock::time_point>{};
+    auto launched = 0;
+    auto launch   = [&running, &launched] {
+        auto begun   = clock::now();
+        auto handler = vb::execution();
+        handler.execute(vb::fs::path{ "/bin/true" });
+        running.emplace(handler.get_pid(), begun);
+        ++launched;
+    };
+
+    auto samples = std::vector<duration>{};
+    samples.reserve(total);
+    auto start = clock::now();
+    while (launched < concurrent) {
+        launch();
+    }
+    while (!running.empty()) {
+        // Whichever child of this process group exits first.
+        auto child = vb::sys::wait_group(0);
+        REQUIRE(child.has_value());
+        auto found = running.find(child.value().pid);
+        if (found == std::end(running)) {
+            continue;
+        }
+        samples.emplace_back(clock::now() - found->second);
+        CHECK(child.value().status == 0);
+        running.erase(found);
+        if (launched < total) {
+            launch();
+        }
+    }
+    auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    auto name = std::to_string(concurrent) + " concurrent children";
+    std::cout << name << ": " << static_cast<double>(samples.size()) / seconds << " spawns/s\n";
+    report(name, std::move(samples));
+}
+
+TEST_CASE("Output throughput of a streaming child", "[.][benchmark][pipe][execute]")
+{
+    static constexpr auto size = std::size_t{ 64 } * vb::MB;
+
+    SECTION("yes")
+    {
+        auto args = std::vector<std::string>{ "-c", "yes | head -c " + std::to_string(size) };
+        CHECK(read_throughput("yes through lines<OUT>()", args) == size);
+        CHECK(read_throughput("yes through chunks<OUT>()", args, reader::CHUNKS) == size);
+        CHECK(read_throughput("yes through merged_lines()", args, reader::MERGED) == size);
+    }
+    SECTION("cat of a large file")
+    {
+        auto path = vb::fs::temp_directory_path() / "vb_spawn_benchmark.txt";
+        {
+            auto file = std::ofstream{ path };
+            auto line = std::string(79, 'x') + "\n";
+            for (auto written = std::size_t{ 0 }; written < size; written += line.size()) {
+                file << line;
+            }
+        }
+        auto args = std::vector<std::string>{ "-c", "cat " + path.string() };
+        CHECK(read_throughput("cat through lines<OUT>()", args) == vb::fs::file_size(path));
+        CHECK(read_throughput("cat through chunks<OUT>()", args, reader::CHUNKS) == vb::fs::file_size(path));
+        CHECK(read_throughput("cat through merged_lines()", args, reader::MERGED) == vb::fs::file_size(path));
+        vb::fs::remove(path);
+    }
+}